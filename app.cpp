@@ -1,12 +1,20 @@
+#include <csignal>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 
 #include "array.hpp"
+#include "autotune.hpp"
+#include "server.hpp"
+#include "telemetry.hpp"
 #include "tridiagonal.hpp"
 
 using cmp::array;
+using cmp::telemetry;
 using cmp::tridiagonal_matrix_solver;
+using cmp::tuned_tridiagonal_matrix_solver;
+using cmp::tuning_table;
 
 using real = double;
 
@@ -35,8 +43,70 @@ bool write(std::ostream& stream, real& value)
     return true;
 }
 
-int main()
+// Benchmarks solve strategies on this machine and writes decision table.
+int tune(size_t n)
 {
+    tuned_tridiagonal_matrix_solver<float>::tune(n);
+    tuned_tridiagonal_matrix_solver<double>::tune(n);
+
+    tuning_table& table = tuning_table::instance();
+    for (size_t bucket = 1; bucket <= tuned_tridiagonal_matrix_solver<double>::bucket_of(n); ++bucket) {
+        std::cout << "n < 2^" << std::setw(2) << bucket << ": float " << std::setw(13)
+                  << tuning_table::name(table.get(sizeof(float), bucket)) << ", double " << std::setw(13)
+                  << tuning_table::name(table.get(sizeof(double), bucket)) << std::endl;
+    }
+
+    std::cout << "Decision table writen to " << tuning_table::path() << "." << std::endl;
+
+    return 0;
+}
+
+cmp::solve_server* serving = nullptr;
+
+void interrupt(int)
+{
+    serving->stop();
+}
+
+// Serves solves over Unix socket until SIGINT or SIGTERM.
+int serve(const char* path, uint64_t budget_us)
+{
+    cmp::server_config config;
+    config.path      = path;
+    config.budget_us = budget_us;
+
+    cmp::solve_server server(config);
+    if (!server.listen()) {
+        std::cerr << "Can't listen on " << path << ": " << strerror(errno) << "." << std::endl;
+        return 1;
+    }
+
+    serving = &server;
+    std::signal(SIGINT, interrupt);
+    std::signal(SIGTERM, interrupt);
+
+    std::cout << "Serving on " << path << "." << std::endl;
+    server.run();
+
+    std::cout << server.stats().requests << " requests in " << server.stats().batches << " batches, "
+              << server.stats().failed << " failed." << std::endl;
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "tune") == 0) {
+        return tune(argc > 2 ? size_t(std::strtoull(argv[2], nullptr, 10)) : size_t(1) << 20);
+    }
+
+    if (argc > 2 && strcmp(argv[1], "serve") == 0) {
+        return serve(argv[2], argc > 3 ? uint64_t(std::strtoull(argv[3], nullptr, 10)) : uint64_t(200));
+    }
+
+    // `app tuned` solves input with tuned strategy, see `autotune.hpp`.
+    bool tuned = argc > 1 && strcmp(argv[1], "tuned") == 0;
+
     std::ifstream input("input.dat");
     if (!input) {
         input.close();
@@ -73,9 +143,28 @@ int main()
     input.close();
     std::cout << "Data read." << std::endl;
 
-    tridiagonal_matrix_solver<real> solver;
-    solver.solve_fast(x, a, b, c);
-    if (!solver.good()) {
+    // Solve statistics are dumped at exit if THOMAS_TELEMETRY is set.
+    bool stats = std::getenv("THOMAS_TELEMETRY") != nullptr;
+    uint16_t site = stats ? telemetry::site("app") : 0;
+
+    // Strategy is tuned only on request, tuning benchmarks & writes cache file at first use.
+    bool good;
+    if (tuned) {
+        tuned_tridiagonal_matrix_solver<real> solver(n);
+        solver.trace(site);
+        solver.solve(x, a, b, c);
+        good = solver.good();
+    } else {
+        tridiagonal_matrix_solver<real> solver(n);
+        solver.trace(site);
+        solver.solve(x, a, b, c);
+        good = solver.good();
+    }
+
+    if (stats) {
+        telemetry::dump(std::cerr);
+    }
+    if (!good) {
         std::cerr << "Can't solve. Bad input system. Zero determinant or division by zero." << std::endl;
         return 1;
     }
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <dlfcn.h>
+
+#include "array.hpp"
+#include "lapack.hpp"
+#include "tridiagonal.hpp"
+
+using cmp::array;
+using cmp::tridiagonal_matrix_solver;
+
+using real       = double;
+using clock_type = std::chrono::steady_clock;
+
+/*
+ * Compares solve modes on the same systems, from cache resident to far beyond last level cache.
+ * Build in Release to get meaningful numbers. Time is the best of several runs, in nanoseconds per row.
+ *
+ * Then `dgtsv_` of this library against reference LAPACK on the same (diagonally dominant) systems.
+ * Reference exports the same symbol, so it is loaded at runtime from `liblapack.so.3`, or from
+ * `THOMAS_LAPACK` enviroment variable, and skipped when there is none.
+ */
+
+struct bench_system {
+    explicit bench_system(size_t n)
+        : a(n)
+        , b(n)
+        , c(n)
+        , d(n)
+        , x(n)
+        , scratch(n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = i == 0 ? real(0) : real(-1) + real(0.1) * real(i % 4);
+            b[i] = real(4) + real(i % 3);
+            c[i] = i == n - 1 ? real(0) : real(-1) - real(0.2) * real(i % 2);
+            d[i] = real(i % 5) - real(2);
+        }
+    }
+
+    array<real> a;
+    array<real> b;
+    array<real> c;
+    array<real> d;
+    array<real> x;
+    array<real> scratch;
+};
+
+// Preparation (restoring `x` and `c`) is not measured.
+template <typename prepare_t, typename solve_t>
+double measure(size_t n, prepare_t prepare, solve_t solve)
+{
+    const size_t repeats = std::max(size_t(3), (size_t(1) << 24) / n);
+
+    double best = 0.0;
+    for (size_t i = 0; i < repeats; ++i) {
+        prepare();
+
+        auto start = clock_type::now();
+        solve();
+        double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+        best = i == 0 ? elapsed : std::min(best, elapsed);
+    }
+
+    return best * 1e9 / double(n);
+}
+
+using gtsv_t = void (*)(const int*, const int*, double*, double*, double*, double*, const int*, int*);
+
+void gtsv_bench()
+{
+    const char* path = std::getenv("THOMAS_LAPACK");
+    void* library    = dlopen(path != nullptr ? path : "liblapack.so.3", RTLD_NOW | RTLD_LOCAL);
+    auto reference   = library != nullptr ? reinterpret_cast<gtsv_t>(dlsym(library, "dgtsv_")) : nullptr;
+
+    if (reference == nullptr) {
+        std::cout << "no reference LAPACK, dgtsv is not compared" << std::endl;
+        return;
+    }
+
+    std::cout << std::endl
+              << std::setw(10) << "n" << std::setw(14) << "dgtsv" << std::setw(14) << "reference" << std::endl;
+
+    for (size_t n : {size_t(1) << 10, size_t(1) << 14, size_t(1) << 18, size_t(1) << 20, size_t(1) << 22}) {
+        bench_system s(n);
+
+        // LAPACK layout, all of it is overwritten by `?gtsv`.
+        array<real> dl(n);
+        array<real> d(n);
+        array<real> du(n);
+        auto restore = [&] {
+            memcpy(dl.data(), s.a.data() + 1, sizeof(real) * (n - 1));
+            memcpy(d.data(), s.b.data(), sizeof(real) * n);
+            memcpy(du.data(), s.c.data(), sizeof(real) * (n - 1));
+            memcpy(s.x.data(), s.d.data(), sizeof(real) * n);
+        };
+
+        const int size = int(n);
+        const int one  = 1;
+        int info       = 0;
+
+        double ours = measure(n, restore, [&] {
+            dgtsv_(&size, &one, dl.data(), d.data(), du.data(), s.x.data(), &size, &info);
+        });
+        double theirs = measure(n, restore, [&] {
+            reference(&size, &one, dl.data(), d.data(), du.data(), s.x.data(), &size, &info);
+        });
+
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(3) << std::setw(14) << ours
+                  << std::setw(14) << theirs << std::endl;
+    }
+
+    dlclose(library);
+}
+
+int main()
+{
+    std::cout << std::setw(10) << "n" << std::setw(14) << "solve_fast" << std::setw(14) << "solve" << std::setw(14)
+              << "solve_slow" << std::setw(14) << "solve_blocked" << std::endl;
+
+    for (size_t n : {size_t(1) << 10, size_t(1) << 14, size_t(1) << 18, size_t(1) << 20, size_t(1) << 22}) {
+        bench_system s(n);
+        tridiagonal_matrix_solver<real> solver(std::max(n, tridiagonal_matrix_solver<real>::blocked_reusable(n)));
+
+        auto restore_x = [&] { memcpy(s.x.data(), s.d.data(), sizeof(real) * n); };
+        auto restore_c = [&] {
+            restore_x();
+            memcpy(s.scratch.data(), s.c.data(), sizeof(real) * n);
+        };
+
+        double fast    = measure(n, restore_c, [&] { solver.solve_fast(s.x, s.a, s.b, s.scratch); });
+        double normal  = measure(n, restore_x, [&] { solver.solve(s.x, s.a, s.b, s.c); });
+        double slow    = measure(n, [] {}, [&] { solver.solve_slow(s.x, s.a, s.b, s.c, s.d); });
+        double blocked = measure(n, restore_x, [&] { solver.solve_blocked(s.x, s.a, s.b, s.c); });
+
+        std::cout << std::setw(10) << n << std::fixed << std::setprecision(3) << std::setw(14) << fast
+                  << std::setw(14) << normal << std::setw(14) << slow << std::setw(14) << blocked << std::endl;
+    }
+
+    gtsv_bench();
+
+    return 0;
+}
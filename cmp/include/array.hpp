@@ -8,23 +8,32 @@
 
 #include "allocator.hpp"
 #include "debug.hpp"
+#include "dispatch.hpp"
 #include "isclose.hpp"
+#include "restrict.hpp"
 
 /*
  * std::vector is too convoluted for our task.
  *
+ * Allocator is a class with static `allocate(size)` & `deallocate(ptr)`, see `allocator.hpp`.
+ * Arithmetic is lazy, arrays are assigned from expressions, see `expression.hpp`.
+ * Bulk loops are compiled for several ISA and picked at runtime, see `dispatch.hpp`.
  */
 
 namespace cmp
 {
 
-template <typename T>
+// Lazy element-wise expression: `size()` and `operator[](i)`, see `expression.hpp`.
+template <typename E>
+concept expression = E::is_expression;
+
+template <typename T, typename allocator_t = allocator>
 class array
 {
 public:
     explicit array(size_t size)
         : size_(size)
-        , data_(reinterpret_cast<T*>(allocator::allocate(sizeof(T) * size_)))
+        , data_(reinterpret_cast<T*>(allocator_t::allocate(sizeof(T) * size_)))
     {
     }
 
@@ -36,7 +45,7 @@ public:
 
     array(const array& other)
         : size_(other.size_)
-        , data_(reinterpret_cast<T*>(allocator::allocate(sizeof(T) * size_)))
+        , data_(reinterpret_cast<T*>(allocator_t::allocate(sizeof(T) * size_)))
     {
         memcpy(data_, other.data_, sizeof(T) * size_);
     }
@@ -51,7 +60,7 @@ public:
 
     array(std::initializer_list<T> l)
         : size_(l.size())
-        , data_(reinterpret_cast<T*>(allocator::allocate(sizeof(T) * size_)))
+        , data_(reinterpret_cast<T*>(allocator_t::allocate(sizeof(T) * size_)))
     {
         auto iter = l.begin();
         for (size_t i = 0; i < size_; ++i) {
@@ -66,13 +75,19 @@ public:
             return false;
         }
 
-        for (size_t i = 0; i < a.size(); ++i) {
-            if (!isclose(a[i], b[i])) {
-                return false;
-            }
+        return dispatch<&mismatches>(a.size(), a.data(), b.data()) == 0;
+    }
+
+    // Whole expression is evaluated in one loop. This array may appear in it only unshifted.
+    template <expression E>
+    array& operator=(const E& e)
+    {
+        if constexpr (debug()) {
+            assert(e.size() >= size_);
         }
 
-        return true;
+        dispatch<&evaluate<E>>(size_, data_, &e);
+        return *this;
     }
 
     const T& operator[](size_t i) const
@@ -109,10 +124,29 @@ public:
 
     ~array()
     {
-        allocator::deallocate(data_);
+        allocator_t::deallocate(data_);
     }
 
 private:
+    // No early exit, so it vectorizes.
+    static size_t mismatches(size_t n, const T* restrict a, const T* restrict b)
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < n; ++i) {
+            result += isclose(a[i], b[i]) ? 0 : 1;
+        }
+        return result;
+    }
+
+    // `data` is not restrict, array may appear in its own expression.
+    template <expression E>
+    static void evaluate(size_t n, T* data, const E* e)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            data[i] = (*e)[i];
+        }
+    }
+
     size_t size_{0};
     T* data_{nullptr};
 };
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "tridiagonal.hpp"
+
+/*
+ * Autotuning of solve strategy.
+ *
+ * Which of `solve_fast(...)`, `solve(...)` & `solve_slow(...)` is faster depends on the machine and system size.
+ * So strategies are benchmarked on this host for each (precision, size bucket), and decision table is
+ * persisted to a cache file. Size bucket is bit width of `n`, so each bucket is a power of 2 range.
+ * Strategies differ mostly by copies they need, so each one is timed as it is dispatched, copies included.
+ *
+ * Bucket is tuned at first use, or explicitly with `tune(...)` (see `app tune`).
+ * Cache file is `tune.dat` in working directory, or `THOMAS_TUNE_CACHE` enviroment variable. Entries are
+ * keyed by CPU model too, so one file may be shared by different machines, each of them uses its own.
+ * Table is safe to use from many threads, file is read & written under a lock.
+ *
+ * All strategies share the contract of `solve(...)`: initialy `x` is `d` and reused, `a`, `b` & `c` preserved.
+ * Strategies that reuse more do a copy into scratch first.
+ *
+ * `solve_blocked` may be set explicitly, but it is not a tuning candidate: it pays 1 more division per row,
+ * and no host measured so far is memory bound enough for that to pay off (see `bench`, about 2x slower
+ * than `solve(...)` from 2^10 to 2^22 rows).
+ *
+ * Solver is single threaded, as everything else here. Batches with the same matrix go through `solve_batch(...)`,
+ * so there are no thread & batch dimensions in decision table.
+ */
+
+namespace cmp
+{
+
+enum class solve_strategy : uint8_t
+{
+    unknown,
+    solve_fast,
+    solve,
+    solve_slow,
+    solve_blocked,
+};
+
+class tuning_table
+{
+public:
+    // Loads cache file on first use.
+    static tuning_table& instance();
+
+    solve_strategy get(size_t precision, size_t bucket) const
+    {
+        return table_[index(precision)][bucket].load(std::memory_order_relaxed);
+    }
+
+    void set(size_t precision, size_t bucket, solve_strategy strategy)
+    {
+        table_[index(precision)][bucket].store(strategy, std::memory_order_relaxed);
+    }
+
+    bool load();
+
+    // Entries of other CPU models in the file are kept.
+    bool save() const;
+
+    static const char* path();
+
+    // CPU model of this host, with no whitespace.
+    static const char* cpu();
+
+    static const char* name(solve_strategy strategy);
+
+    static constexpr size_t buckets = 65;
+
+private:
+    tuning_table();
+
+    static size_t index(size_t precision)
+    {
+        return precision == sizeof(float) ? 0 : precision == sizeof(double) ? 1 : 2;
+    }
+
+    static constexpr size_t precisions = 3;
+
+    std::atomic<solve_strategy> table_[precisions][buckets];
+    mutable std::mutex file_;
+};
+
+template <typename real = float>
+class tuned_tridiagonal_matrix_solver
+{
+public:
+    tuned_tridiagonal_matrix_solver(size_t reusable)
+        : solver_(std::max(reusable, tridiagonal_matrix_solver<real>::blocked_reusable(reusable)))
+        , scratch_(reusable)
+        , table_(tuning_table::instance())
+    {
+    }
+
+    void solve(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        size_t bucket = bucket_of(x.size());
+
+        solve_strategy strategy = table_.get(sizeof(real), bucket);
+        if (strategy == solve_strategy::unknown) {
+            [[unlikely]] strategy = tune_bucket(bucket, x.size());
+        }
+
+        solve(strategy, x, a, b, c);
+    }
+
+    void solve(solve_strategy strategy, array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        if constexpr (debug()) {
+            assert((x.size() <= scratch_.size()) && "Not enough reusable space for me!");
+        }
+
+        switch (strategy) {
+            case solve_strategy::solve_fast:
+                memcpy(scratch_.data(), c.data(), sizeof(real) * c.size());
+                solver_.solve_fast(x, a, b, scratch_);
+                break;
+            case solve_strategy::solve_slow:
+                memcpy(scratch_.data(), x.data(), sizeof(real) * x.size());
+                solver_.solve_slow(x, a, b, c, scratch_);
+                break;
+            case solve_strategy::solve_blocked:
+                solver_.solve_blocked(x, a, b, c);
+                break;
+            case solve_strategy::unknown:
+            case solve_strategy::solve:
+            default:
+                solver_.solve(x, a, b, c);
+                break;
+        }
+    }
+
+    bool good() const
+    {
+        return solver_.good();
+    }
+
+    void trace(uint16_t site)
+    {
+        solver_.trace(site);
+    }
+
+    // Benchmarks every bucket up to bit width of `n` and saves decision table.
+    static void tune(size_t n)
+    {
+        for (size_t bucket = 1; bucket <= bucket_of(n); ++bucket) {
+            tune_bucket(bucket, representative(bucket));
+        }
+    }
+
+    static size_t bucket_of(size_t n)
+    {
+        return size_t(std::bit_width(n));
+    }
+
+private:
+    // Middle of the bucket.
+    static size_t representative(size_t bucket)
+    {
+        return bucket < 2 ? 1 : size_t(3) << (bucket - 2);
+    }
+
+    static solve_strategy tune_bucket(size_t bucket, size_t n)
+    {
+        using clock = std::chrono::steady_clock;
+
+        array<real> a(n);
+        array<real> b(n);
+        array<real> c(n);
+        array<real> d(n);
+        array<real> x(n);
+
+        // Diagonally dominant, so nothing degrades into denormals.
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = i == 0 ? real(0) : real(-1);
+            b[i] = real(4);
+            c[i] = i == n - 1 ? real(0) : real(-1);
+            d[i] = real(i % 7);
+        }
+
+        tuned_tridiagonal_matrix_solver solver(n);
+
+        // Around 2^18 rows per measurement.
+        const size_t repeats = std::max(size_t(1), (size_t(1) << 18) / n);
+
+        solve_strategy strategies[] = {
+            solve_strategy::solve_fast,
+            solve_strategy::solve,
+            solve_strategy::solve_slow,
+        };
+        solve_strategy best         = solve_strategy::solve;
+        double best_time            = 0.0;
+
+        // Exactly the call that is dispatched, copies into scratch included. Refill of `x` is the same
+        // for all strategies, so it does not change the ranking. Best of 3 trials.
+        for (solve_strategy strategy : strategies) {
+            double time = 0.0;
+
+            for (size_t trial = 0; trial < 3; ++trial) {
+                auto start = clock::now();
+                for (size_t i = 0; i < repeats; ++i) {
+                    memcpy(x.data(), d.data(), sizeof(real) * n);
+                    solver.solve(strategy, x, a, b, c);
+                }
+                double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+
+                time = trial == 0 ? elapsed : std::min(time, elapsed);
+            }
+
+            if (best_time <= 0.0 || time < best_time) {
+                best      = strategy;
+                best_time = time;
+            }
+        }
+
+        tuning_table& table = tuning_table::instance();
+        table.set(sizeof(real), bucket, best);
+        table.save();
+
+        return best;
+    }
+
+    tridiagonal_matrix_solver<real> solver_;
+    array<real> scratch_;
+    tuning_table& table_;
+};
+} // namespace cmp
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+
+#include "forceinline.hpp"
+
+/*
+ * Runtime ISA dispatch.
+ *
+ * Build targets compiler baseline (SSE2 on x86-64), so one binary runs everywhere. Hot kernels are
+ * compiled again for AVX2 and AVX-512 by `dispatch<kernel>(args...)`: it instantiates thin wrappers
+ * with `target` attribute, the kernel is inlined into each of them and vectorized for that ISA.
+ * Wrapper is picked by `isa_dispatch::selected()` on each call, that is one predictable branch.
+ *
+ * Level is detected once at startup with CPUID (`__builtin_cpu_supports`, which also checks that OS
+ * saves wide registers). `THOMAS_ISA` enviroment variable (`baseline`, `avx2` or `avx512`) lowers it,
+ * for testing & for comparing. Level above detected is never selected.
+ *
+ * Until static initialization is done, and on other architectures, baseline is used.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CMP_MULTIVERSION 1
+#endif
+
+namespace cmp
+{
+
+enum class isa : uint8_t
+{
+    baseline,
+    avx2,
+    avx512,
+};
+
+class isa_dispatch
+{
+public:
+    // Best level this CPU supports.
+    static isa detected();
+
+    static isa selected()
+    {
+        return selected_;
+    }
+
+    // Overrides selection, clamped to detected level. Returns level in effect.
+    // Not synchronized with solves running in other threads.
+    static isa select(isa level);
+
+    static const char* name(isa level);
+
+    // `baseline`, `avx2` or `avx512`, false for anything else.
+    static bool parse(const char* name, isa& level);
+
+private:
+    static isa selected_;
+};
+
+#ifdef CMP_MULTIVERSION
+
+template <auto kernel, typename... args_t>
+__attribute__((target("avx2"))) auto isa_avx2(args_t... args)
+{
+    return kernel(args...);
+}
+
+template <auto kernel, typename... args_t>
+__attribute__((target("avx512f"))) auto isa_avx512(args_t... args)
+{
+    return kernel(args...);
+}
+
+#endif
+
+// Calls `kernel` compiled for selected level. Arguments are taken by value, pass pointers.
+template <auto kernel, typename... args_t>
+auto forceinline dispatch(args_t... args)
+{
+#ifdef CMP_MULTIVERSION
+    switch (isa_dispatch::selected()) {
+        case isa::avx512:
+            return isa_avx512<kernel>(args...);
+        case isa::avx2:
+            return isa_avx2<kernel>(args...);
+        case isa::baseline:
+        default:
+            break;
+    }
+#endif
+
+    return kernel(args...);
+}
+} // namespace cmp
@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <cfenv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+#include "mod.hpp"
+#include "restrict.hpp"
+#include "tridiagonal_pivoting.hpp"
+
+/*
+ * Eigenvalues & eigenvectors of symmetric tridiagonal matrix.
+ *
+ * Matrix is stored as in `tridiagonal.hpp`, symmetric means a[i + 1] == c[i], so only `b` & `c` are read.
+ * Eigenvalues are numbered from 0 in ascending order.
+ *
+ * Eigenvalues are found by bisection with Sturm counts: number of eigenvalues below x is number of
+ * negative pivots of T - x I, that is the same recurrence as `determinant(...)`:
+ *
+ *     q[0] = b[0] - x, q[i] = b[i] - x - c[i - 1]^2 / q[i - 1]
+ *
+ * Sweep evaluates `lanes` shifts at once, inner loop runs over shifts, so it vectorizes. Each shift bisects
+ * its own eigenvalue for a fixed number of steps (until Gershgorin interval shrinks to rounding), so there
+ * are no data dependent branches at all. Groups of eigenvalues are split between threads: workers are started
+ * on the first big enough problem and parked between calls, small problems are bisected in calling thread.
+ *
+ * Eigenvectors come from inverse iteration with `pivoting_tridiagonal_matrix_solver` kernels, shift is
+ * nudged off the eigenvalue by rounding level, so T - x I is factored without exact zero pivots.
+ * Vectors of close eigenvalues are orthogonalized against each other.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class symmetric_eigen_solver
+{
+public:
+    static constexpr size_t lanes       = 16;
+    static constexpr size_t max_threads = 64;
+
+    // `threads` is used for eigenvalues only, eigenvectors are found in calling thread.
+    explicit symmetric_eigen_solver(size_t n, size_t threads = 1)
+        : n_(n)
+        , threads_(std::clamp(threads, size_t(1), max_threads))
+        , e2_(n)
+        , dl_(n)
+        , d_(n)
+        , du_(n)
+        , du2_(n)
+        , pivots_(n)
+    {
+    }
+
+    ~symmetric_eigen_solver()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+
+        for (size_t t = 1; t < started_; ++t) {
+            workers_[t].join();
+        }
+    }
+
+    symmetric_eigen_solver(const symmetric_eigen_solver&) = delete;
+
+    symmetric_eigen_solver& operator=(const symmetric_eigen_solver&) = delete;
+
+    // Number of eigenvalues below `x`.
+    size_t count(const array<real>& b, const array<real>& c, real x)
+    {
+        prepare(b, c);
+
+        real shifts[lanes];
+        size_t counts[lanes];
+        std::fill(shifts, shifts + lanes, x);
+
+        sturm(n_, b.data(), e2_.data(), pivmin_, shifts, counts);
+        return counts[0];
+    }
+
+    // Eigenvalues with indices [first, last) into `values[0, last - first)`.
+    void eigenvalues(const array<real>& b, const array<real>& c, size_t first, size_t last, array<real>& values)
+    {
+        if constexpr (debug()) {
+            assert(first <= last && last <= n_);
+            assert(values.size() >= last - first);
+        }
+
+        prepare(b, c);
+        bisect(b, first, last, values.data());
+    }
+
+    // Eigenvalues in [low, high) into `values`, returns how many of them there are.
+    size_t eigenvalues_between(const array<real>& b, const array<real>& c, real low, real high, array<real>& values)
+    {
+        size_t first = count(b, c, low);
+        size_t last  = count(b, c, high);
+
+        if constexpr (debug()) {
+            assert(values.size() >= last - first);
+        }
+
+        bisect(b, first, last, values.data());
+        return last - first;
+    }
+
+    // Unit eigenvectors for `count` eigenvalues in ascending order, vector `k` is `vectors[k * n, (k + 1) * n)`.
+    void eigenvectors(
+        const array<real>& b,
+        const array<real>& c,
+        const array<real>& values,
+        size_t count,
+        array<real>& vectors)
+    {
+        const size_t n = n_;
+
+        if constexpr (debug()) {
+            assert(values.size() >= count);
+            assert(vectors.size() >= count * n);
+        }
+
+        prepare(b, c);
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        const real tiny = std::numeric_limits<real>::epsilon() * norm_;
+
+        // First vector of the current cluster of close eigenvalues.
+        size_t cluster = 0;
+
+        for (size_t k = 0; k < count; ++k) {
+            if (k > 0 && values[k] - values[k - 1] > real(1e-3) * norm_) {
+                cluster = k;
+            }
+
+            const real shift = values[k] + tiny;
+            real* restrict x = vectors.data() + k * n;
+
+            for (size_t i = 0; i < n; ++i) {
+                d_[i] = b[i] - shift;
+                if (i + 1 < n) {
+                    dl_[i] = c[i];
+                    du_[i] = c[i];
+                }
+            }
+
+            pivoting_tridiagonal_matrix_solver<real>::factor(
+                n, dl_.data(), d_.data(), du_.data(), du2_.data(), pivots_.data());
+
+            for (size_t i = 0; i < n; ++i) {
+                if (mod(d_[i]) < tiny) {
+                    [[unlikely]] d_[i] = std::signbit(d_[i]) ? -tiny : tiny;
+                }
+            }
+
+            // Deterministic start, not orthogonal to anything in particular.
+            uint32_t seed = uint32_t(2654435761u * (k + 1));
+            for (size_t i = 0; i < n; ++i) {
+                seed = seed * 1664525u + 1013904223u;
+                x[i] = real(1) + real(seed >> 8) / real(1 << 24);
+            }
+
+            for (size_t iteration = 0; iteration < iterations; ++iteration) {
+                pivoting_tridiagonal_matrix_solver<real>::solve(
+                    n, x, dl_.data(), d_.data(), du_.data(), du2_.data(), pivots_.data());
+
+                for (size_t j = cluster; j < k; ++j) {
+                    const real* restrict y = vectors.data() + j * n;
+
+                    real dot = real(0);
+                    for (size_t i = 0; i < n; ++i) {
+                        dot += x[i] * y[i];
+                    }
+                    for (size_t i = 0; i < n; ++i) {
+                        x[i] -= dot * y[i];
+                    }
+                }
+
+                normalize(n, x);
+            }
+        }
+
+        good_ = !std::fetestexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+    // Raw kernel: Sturm counts for `lanes` shifts, `e2[i]` is c[i]^2. Pivots smaller than `pivmin`
+    // are replaced with -pivmin, so there is no division by zero.
+    // Counts are accumulated in `real`, that is what vectorizes, so `n` is below 2^24 for float.
+    static void forceinline sturm(
+        const size_t n,
+        const real* restrict b,
+        const real* restrict e2,
+        const real pivmin,
+        const real* restrict shifts,
+        size_t* restrict counts)
+    {
+        real q[lanes];
+        real negative[lanes];
+
+        for (size_t k = 0; k < lanes; ++k) {
+            real p      = b[0] - shifts[k];
+            p           = (p < pivmin && p > -pivmin) ? -pivmin : p;
+            q[k]        = p;
+            negative[k] = p < real(0) ? real(1) : real(0);
+        }
+
+        for (size_t i = 1; i < n; ++i) {
+            const real bi = b[i];
+            const real ei = e2[i - 1];
+
+            for (size_t k = 0; k < lanes; ++k) {
+                real p = (bi - shifts[k]) - ei / q[k];
+                p      = (p < pivmin && p > -pivmin) ? -pivmin : p;
+                q[k]   = p;
+                negative[k] += p < real(0) ? real(1) : real(0);
+            }
+        }
+
+        for (size_t k = 0; k < lanes; ++k) {
+            counts[k] = size_t(negative[k]);
+        }
+    }
+
+private:
+    static constexpr size_t iterations = 3;
+
+    // Below this many `sturm(...)` rows per bisection step waking workers costs more than it saves.
+    static constexpr size_t serial_work = size_t(1) << 15;
+
+    // Squared off diagonal, Gershgorin interval and pivot threshold.
+    void prepare(const array<real>& b, const array<real>& c)
+    {
+        const size_t n = n_;
+
+        if constexpr (debug()) {
+            assert(b.size() == n);
+            assert(c.size() == n);
+        }
+
+        real low  = b[0];
+        real high = b[0];
+        real emax = real(0);
+
+        for (size_t i = 0; i < n; ++i) {
+            real left  = i > 0 ? mod(c[i - 1]) : real(0);
+            real right = i + 1 < n ? mod(c[i]) : real(0);
+
+            low  = std::min(low, b[i] - left - right);
+            high = std::max(high, b[i] + left + right);
+
+            if (i + 1 < n) {
+                e2_[i] = c[i] * c[i];
+                emax   = std::max(emax, e2_[i]);
+            }
+        }
+
+        norm_ = std::max({mod(low), mod(high), std::numeric_limits<real>::min()});
+
+        const real slack = real(2) * std::numeric_limits<real>::epsilon() * norm_;
+        low_             = low - slack;
+        high_            = high + slack;
+        pivmin_          = std::numeric_limits<real>::min() * std::max(real(1), emax);
+    }
+
+    void bisect(const array<real>& b, size_t first, size_t last, real* restrict values)
+    {
+        const size_t total = last - first;
+        if (total == 0) {
+            return;
+        }
+
+        // Enough work per thread to pay for its wake up.
+        const size_t groups  = (total + lanes - 1) / lanes;
+        const size_t threads = n_ * total < serial_work ? 1 : std::min(threads_, (groups + 3) / 4);
+
+        if (threads <= 1) {
+            bisect_groups(b.data(), first, last, values);
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            job_     = {b.data(), first, last, (groups + threads - 1) / threads * lanes, values};
+            active_  = threads;
+            pending_ = threads - 1;
+            ++generation_;
+        }
+
+        for (; started_ < threads; ++started_) {
+            workers_[started_] = std::thread([this, t = started_] { work(t); });
+        }
+        wake_.notify_all();
+
+        // Calling thread takes the first share.
+        bisect_share(0);
+
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+    // Worker `t` bisects its share of each job until the solver is destroyed.
+    void work(size_t t)
+    {
+        uint64_t seen = 0;
+
+        for (;;) {
+            {
+                std::unique_lock lock(mutex_);
+                wake_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+
+                seen = generation_;
+                if (t >= active_) {
+                    continue;
+                }
+            }
+
+            bisect_share(t);
+
+            {
+                std::lock_guard lock(mutex_);
+                --pending_;
+            }
+            done_.notify_one();
+        }
+    }
+
+    void bisect_share(size_t t)
+    {
+        const size_t total = job_.last - job_.first;
+        const size_t from  = job_.first + std::min(total, t * job_.per_thread);
+        const size_t to    = job_.first + std::min(total, (t + 1) * job_.per_thread);
+
+        bisect_groups(job_.b, from, to, job_.values + (from - job_.first));
+    }
+
+    void bisect_groups(const real* restrict b, size_t first, size_t last, real* restrict values) const
+    {
+        const real tolerance = real(2) * std::numeric_limits<real>::epsilon() * norm_;
+        const size_t steps   = size_t(std::ceil(std::log2(std::max((high_ - low_) / tolerance, real(2))))) + 2;
+
+        real low[lanes];
+        real high[lanes];
+        real mid[lanes];
+        size_t counts[lanes];
+
+        for (size_t group = first; group < last; group += lanes) {
+            const size_t width = std::min(lanes, last - group);
+
+            std::fill(low, low + lanes, low_);
+            std::fill(high, high + lanes, high_);
+
+            for (size_t step = 0; step < steps; ++step) {
+                for (size_t k = 0; k < lanes; ++k) {
+                    mid[k] = (low[k] + high[k]) * real(0.5);
+                }
+
+                sturm(n_, b, e2_.data(), pivmin_, mid, counts);
+
+                // Eigenvalue `group + k` is below `mid` when more than `group + k` eigenvalues are.
+                for (size_t k = 0; k < lanes; ++k) {
+                    const bool below = counts[k] > group + k;
+                    high[k]          = below ? mid[k] : high[k];
+                    low[k]           = below ? low[k] : mid[k];
+                }
+            }
+
+            for (size_t k = 0; k < width; ++k) {
+                values[group - first + k] = (low[k] + high[k]) * real(0.5);
+            }
+        }
+    }
+
+    static void normalize(size_t n, real* restrict x)
+    {
+        real scale = real(0);
+        for (size_t i = 0; i < n; ++i) {
+            scale = std::max(scale, mod(x[i]));
+        }
+
+        real sum = real(0);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] /= scale;
+            sum += x[i] * x[i];
+        }
+
+        const real inverse = real(1) / std::sqrt(sum);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] *= inverse;
+        }
+    }
+
+    size_t n_;
+    size_t threads_;
+
+    array<real> e2_;
+    real low_{0};
+    real high_{0};
+    real norm_{1};
+    real pivmin_{0};
+
+    // Inverse iteration factors, LAPACK layout.
+    array<real> dl_;
+    array<real> d_;
+    array<real> du_;
+    array<real> du2_;
+    array<int> pivots_;
+
+    bool good_{false};
+
+    // Current bisection split into `active_` shares, share 0 is done by calling thread.
+    struct job {
+        const real* b;
+        size_t first;
+        size_t last;
+        size_t per_thread;
+        real* values;
+    };
+
+    job job_{};
+    size_t active_{0};
+    size_t pending_{0};
+    uint64_t generation_{0};
+    bool stopping_{false};
+
+    // Workers [1, started_) are running, slot 0 is never used.
+    std::thread workers_[max_threads];
+    size_t started_{1};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+};
+} // namespace cmp
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+
+/*
+ * Lazy arithmetic on `array`, so right parts are built without temporaries:
+ *
+ *     d = alpha * u + beta * (shift(u, -1) + shift(u, 1)) + f * dt;
+ *
+ * Operators build a tree of small nodes holding pointers to arrays, nothing is computed until assignment.
+ * Assignment evaluates the whole tree in one loop, which inlines into plain arithmetic and vectorizes.
+ * Expression may also go straight into `tridiagonal_matrix_solver::solve_slow(...)` as `d`, then `d` is
+ * never materialized at all.
+ *
+ * Supported are `+`, `-`, `*`, `/`, unary `-`, scalar broadcast and `shift(e, offset)`, which reads
+ * element `i + offset`. Shifted reads are not checked against array bounds except in debug,
+ * so rows where neighbours are missing are assigned separately, with `assign(x, e, first, last)`.
+ *
+ * Nodes keep pointers, so expression must not outlive arrays it was built from.
+ * Scalars are converted to element type of the other operand, so `array<float> * 0.5` stays in float.
+ */
+
+namespace cmp
+{
+
+template <typename T>
+class array_expression
+{
+public:
+    static constexpr bool is_expression = true;
+    using value_type                    = T;
+
+    template <typename allocator_t>
+    array_expression(const array<T, allocator_t>& a)
+        : data_(a.data())
+        , size_(a.size())
+    {
+    }
+
+    T forceinline operator[](size_t i) const
+    {
+        if constexpr (debug()) {
+            assert(i < size_ && "Out of bounds!");
+        }
+        return data_[i];
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    const T* data_;
+    size_t size_;
+};
+
+template <typename T>
+class scalar_expression
+{
+public:
+    static constexpr bool is_expression = true;
+    using value_type                    = T;
+
+    explicit scalar_expression(T value)
+        : value_(value)
+    {
+    }
+
+    T forceinline operator[](size_t) const
+    {
+        return value_;
+    }
+
+    // Broadcasts to any size.
+    size_t size() const
+    {
+        return std::numeric_limits<size_t>::max();
+    }
+
+private:
+    T value_;
+};
+
+template <typename E>
+class shifted_expression
+{
+public:
+    static constexpr bool is_expression = true;
+    using value_type                    = typename E::value_type;
+
+    shifted_expression(const E& e, ptrdiff_t offset)
+        : e_(e)
+        , offset_(offset)
+    {
+    }
+
+    value_type forceinline operator[](size_t i) const
+    {
+        return e_[size_t(ptrdiff_t(i) + offset_)];
+    }
+
+    size_t size() const
+    {
+        return e_.size();
+    }
+
+private:
+    E e_;
+    ptrdiff_t offset_;
+};
+
+template <typename E>
+class negate_expression
+{
+public:
+    static constexpr bool is_expression = true;
+    using value_type                    = typename E::value_type;
+
+    explicit negate_expression(const E& e)
+        : e_(e)
+    {
+    }
+
+    value_type forceinline operator[](size_t i) const
+    {
+        return -e_[i];
+    }
+
+    size_t size() const
+    {
+        return e_.size();
+    }
+
+private:
+    E e_;
+};
+
+template <typename op, typename L, typename R>
+class binary_expression
+{
+public:
+    static constexpr bool is_expression = true;
+    using value_type                    = typename L::value_type;
+
+    static_assert(std::is_same_v<typename L::value_type, typename R::value_type>, "Mixed precision expression!");
+
+    binary_expression(const L& l, const R& r)
+        : l_(l)
+        , r_(r)
+    {
+    }
+
+    value_type forceinline operator[](size_t i) const
+    {
+        return op::apply(l_[i], r_[i]);
+    }
+
+    size_t size() const
+    {
+        return l_.size() < r_.size() ? l_.size() : r_.size();
+    }
+
+private:
+    L l_;
+    R r_;
+};
+
+struct add {
+    template <typename T>
+    static T forceinline apply(T l, T r)
+    {
+        return l + r;
+    }
+};
+
+struct subtract {
+    template <typename T>
+    static T forceinline apply(T l, T r)
+    {
+        return l - r;
+    }
+};
+
+struct multiply {
+    template <typename T>
+    static T forceinline apply(T l, T r)
+    {
+        return l * r;
+    }
+};
+
+struct divide {
+    template <typename T>
+    static T forceinline apply(T l, T r)
+    {
+        return l / r;
+    }
+};
+
+// Operand conversion: arrays become `array_expression`, expressions are copied as is.
+
+template <typename T>
+struct is_array : std::false_type {
+};
+
+template <typename T, typename allocator_t>
+struct is_array<array<T, allocator_t>> : std::true_type {
+};
+
+template <typename T>
+concept operand = expression<T> || is_array<T>::value;
+
+template <typename T, typename allocator_t>
+array_expression<T> forceinline lift(const array<T, allocator_t>& a)
+{
+    return array_expression<T>(a);
+}
+
+template <expression E>
+E forceinline lift(const E& e)
+{
+    return e;
+}
+
+template <operand E>
+using lifted = decltype(lift(std::declval<const E&>()));
+
+template <typename op, operand L, operand R>
+auto forceinline combine(const L& l, const R& r)
+{
+    return binary_expression<op, lifted<L>, lifted<R>>(lift(l), lift(r));
+}
+
+template <typename op, operand L, typename S>
+    requires std::is_arithmetic_v<S>
+auto forceinline combine(const L& l, S s)
+{
+    using T = typename lifted<L>::value_type;
+    return binary_expression<op, lifted<L>, scalar_expression<T>>(lift(l), scalar_expression<T>(T(s)));
+}
+
+template <typename op, typename S, operand R>
+    requires std::is_arithmetic_v<S>
+auto forceinline combine(S s, const R& r)
+{
+    using T = typename lifted<R>::value_type;
+    return binary_expression<op, scalar_expression<T>, lifted<R>>(scalar_expression<T>(T(s)), lift(r));
+}
+
+// Any pair of array, expression and scalar, but not 2 scalars.
+template <typename L, typename R>
+concept operands = (operand<L> && (operand<R> || std::is_arithmetic_v<R>)) || (std::is_arithmetic_v<L> && operand<R>);
+
+template <typename L, typename R>
+    requires operands<L, R>
+auto operator+(const L& l, const R& r)
+{
+    return combine<add>(l, r);
+}
+
+template <typename L, typename R>
+    requires operands<L, R>
+auto operator-(const L& l, const R& r)
+{
+    return combine<subtract>(l, r);
+}
+
+template <typename L, typename R>
+    requires operands<L, R>
+auto operator*(const L& l, const R& r)
+{
+    return combine<multiply>(l, r);
+}
+
+template <typename L, typename R>
+    requires operands<L, R>
+auto operator/(const L& l, const R& r)
+{
+    return combine<divide>(l, r);
+}
+
+template <operand E>
+auto operator-(const E& e)
+{
+    return negate_expression<lifted<E>>(lift(e));
+}
+
+// Element `i` of result is element `i + offset` of `e`.
+template <operand E>
+auto shift(const E& e, ptrdiff_t offset)
+{
+    return shifted_expression<lifted<E>>(lift(e), offset);
+}
+
+// Evaluates rows [first, last) only.
+template <typename T, typename allocator_t, expression E>
+void assign(array<T, allocator_t>& x, const E& e, size_t first, size_t last)
+{
+    if constexpr (debug()) {
+        assert(first <= last && last <= x.size());
+    }
+
+    T* data = x.data();
+    for (size_t i = first; i < last; ++i) {
+        data[i] = e[i];
+    }
+}
+} // namespace cmp
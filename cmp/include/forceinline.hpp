@@ -8,7 +8,8 @@
 #if defined(__clang__)
 #define forceinline __attribute__((always_inline))
 #elif defined(__GNUC__) || defined(__GNUG__)
-#define forceinline __inline__
+// Plain `inline` is only a hint for GCC, it gives up on it once unit growth limit is reached (-Winline).
+#define forceinline __inline__ __attribute__((always_inline))
 #elif defined(_MSC_VER)
 #define forceinline __forceinline
 #else
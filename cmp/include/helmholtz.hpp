@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "dispatch.hpp"
+#include "restrict.hpp"
+#include "sine_transform.hpp"
+#include "tridiagonal.hpp"
+
+/*
+ * Fast direct solver of Helmholtz (Poisson for sigma = 0) equation on a rectangular 2D or 3D grid:
+ *
+ *     laplace(u) - sigma * u = f, sigma >= 0
+ *
+ * with 5 (7) point stencil and zero Dirichlet boundary. Grid holds interior points only, x is the fastest
+ * axis: u[j * nx + i] in 2D, u[(l * ny + j) * nx + i] in 3D. Nonzero boundary values are moved into `f`
+ * by client, as usual.
+ *
+ * Algorithm:
+ *  1. DST along x (and y in 3D) diagonalizes second differences along them, see `sine_transform.hpp`.
+ *  2. Each mode leaves an independent tridiagonal system along the last axis. Modes of one row along that
+ *     axis are contiguous, that is the interleaved layout, so all lines are solved at once by
+ *     `solve_interleaved(...)` kernel of `tridiagonal_matrix_solver`, inner loop runs over modes.
+ *     Coefficients of all lines are built in ctor.
+ *  3. DST back. Normalization of inverse DST is folded into line systems.
+ *
+ * In 3D planes are transposed around DST along y, so it runs over contiguous lines too.
+ *
+ * Lines are strictly diagonally dominant, so there is no pivoting. Cost is O(N log N) for N grid points,
+ * instead of iterations of an iterative solver. All space is allocated in ctor.
+ * Like in `solve(...)` of `tridiagonal_matrix_solver`, initialy `u` is `f` and reused.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class helmholtz_solver
+{
+public:
+    helmholtz_solver(size_t nx, size_t ny, real hx, real hy, real sigma = real(0))
+        : helmholtz_solver(nx, ny, 1, hx, hy, real(1), sigma, false)
+    {
+    }
+
+    helmholtz_solver(size_t nx, size_t ny, size_t nz, real hx, real hy, real hz, real sigma = real(0))
+        : helmholtz_solver(nx, ny, nz, hx, hy, hz, sigma, true)
+    {
+    }
+
+    void solve(array<real>& u)
+    {
+        if constexpr (debug()) {
+            assert(u.size() == nx_ * ny_ * nz_);
+        }
+
+        real* restrict grid = u.data();
+        real* restrict work = work_.data();
+
+        const size_t plane = nx_ * ny_;
+
+        x_.apply_lines(grid, ny_ * nz_);
+
+        if (volume_) {
+            for (size_t l = 0; l < nz_; ++l) {
+                transpose(grid + l * plane, work + l * plane, ny_, nx_);
+                y_.apply_lines(work + l * plane, nx_);
+            }
+
+            lines(work);
+
+            for (size_t l = 0; l < nz_; ++l) {
+                y_.apply_lines(work + l * plane, nx_);
+                transpose(work + l * plane, grid + l * plane, nx_, ny_);
+            }
+        } else {
+            lines(grid);
+        }
+
+        x_.apply_lines(grid, ny_ * nz_);
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+private:
+    helmholtz_solver(size_t nx, size_t ny, size_t nz, real hx, real hy, real hz, real sigma, bool volume)
+        : nx_(nx)
+        , ny_(ny)
+        , nz_(nz)
+        , volume_(volume)
+        , x_(nx)
+        , y_(volume ? ny : 0)
+        , lambda_x_(nx)
+        , lambda_y_(volume ? ny : 0)
+        , work_(volume ? nx * ny * nz : 0)
+        , a_(nx * ny * nz)
+        , b_(nx * ny * nz)
+        , c_(nx * ny * nz)
+        , r_(nx * ny * nz)
+        , pivots_(volume ? nx * ny : nx)
+    {
+        eigenvalues(lambda_x_, hx);
+        eigenvalues(lambda_y_, hy);
+
+        // Inverse transforms are scaled here: solution of (A / s) y = f is s * A^-1 f.
+        const real scale = volume ? x_.scale() * y_.scale() : x_.scale();
+
+        const real h        = volume ? hz : hy;
+        const real off      = real(1) / (h * h * scale);
+        const real diagonal = (real(-2) / (h * h) - sigma) / scale;
+
+        // Interleaved as `x`, mode `k` of row `i` is at `i * count + k`.
+        const size_t count = pivots_.size();
+        const size_t n     = b_.size() / count;
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t k = 0; k < count; ++k) {
+                real lambda = volume ? lambda_x_[k / ny] + lambda_y_[k % ny] : lambda_x_[k];
+
+                a_[i * count + k] = off;
+                b_[i * count + k] = diagonal + lambda / scale;
+                c_[i * count + k] = off;
+            }
+        }
+    }
+
+    // Eigenvalues of Dirichlet second difference: -4 / h^2 * sin^2(pi * (k + 1) / (2 * (n + 1))).
+    static void eigenvalues(array<real>& lambda, real h)
+    {
+        const size_t n = lambda.size();
+        for (size_t k = 0; k < n; ++k) {
+            double s  = std::sin(std::numbers::pi * double(k + 1) / double(2 * (n + 1)));
+            lambda[k] = real(-4.0 * s * s / (double(h) * double(h)));
+        }
+    }
+
+    // Lines of all modes along the last axis at once, `grid` is interleaved.
+    void lines(real* restrict grid)
+    {
+        const size_t count = pivots_.size();
+        const size_t n     = b_.size() / count;
+
+        dispatch<&tridiagonal_matrix_solver<real>::solve_interleaved>(
+            n, count, grid, a_.data() + count, b_.data(), c_.data(), r_.data(), pivots_.data());
+
+        // Line divided by zero exactly when its smallest pivot is 0, no floating point enviroment needed.
+        good_ = true;
+        for (size_t k = 0; k < count; ++k) {
+            good_ = good_ && std::fpclassify(pivots_[k]) != FP_ZERO;
+        }
+    }
+
+    // `to` is `rows` x `cols` matrix `from` transposed, in tiles that fit in L1.
+    static void transpose(const real* restrict from, real* restrict to, size_t rows, size_t cols)
+    {
+        constexpr size_t tile = 32;
+
+        for (size_t i0 = 0; i0 < rows; i0 += tile) {
+            for (size_t j0 = 0; j0 < cols; j0 += tile) {
+                const size_t i1 = std::min(rows, i0 + tile);
+                const size_t j1 = std::min(cols, j0 + tile);
+
+                for (size_t i = i0; i < i1; ++i) {
+                    for (size_t j = j0; j < j1; ++j) {
+                        to[j * rows + i] = from[i * cols + j];
+                    }
+                }
+            }
+        }
+    }
+
+    size_t nx_;
+    size_t ny_;
+    size_t nz_;
+    bool volume_;
+
+    sine_transform<real> x_;
+    sine_transform<real> y_;
+    array<real> lambda_x_;
+    array<real> lambda_y_;
+
+    array<real> work_;
+
+    array<real> a_;
+    array<real> b_;
+    array<real> c_;
+    array<real> r_;
+    array<real> pivots_;
+
+    bool good_{false};
+};
+} // namespace cmp
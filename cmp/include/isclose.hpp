@@ -1,5 +1,7 @@
 #pragma once
 
+#include <complex>
+
 #include "mod.hpp"
 
 namespace cmp
@@ -26,6 +28,24 @@ constexpr long double eps<long double>()
     return 0x1p-63l; // 1.084e-19
 };
 
+template <>
+constexpr std::complex<float> eps<std::complex<float>>()
+{
+    return {eps<float>(), 0.0f};
+};
+
+template <>
+constexpr std::complex<double> eps<std::complex<double>>()
+{
+    return {eps<double>(), 0.0};
+};
+
+template <>
+constexpr std::complex<long double> eps<std::complex<long double>>()
+{
+    return {eps<long double>(), 0.0l};
+};
+
 static_assert(eps<float>() > 0.0f);
 static_assert(eps<double>() > 0.0);
 static_assert(eps<long double>() > 0.0l);
@@ -40,4 +60,11 @@ inline bool isclose(real a, real b, real sigma = 10.0)
 {
     return mod(a - b) < eps<real>() * sigma;
 }
+
+// Complex numbers are close when distance between them on the plane is small.
+template <typename real>
+inline bool isclose(std::complex<real> a, std::complex<real> b, real sigma = 10.0)
+{
+    return mod(a - b) < eps<real>() * sigma;
+}
 } // namespace cmp
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <complex>
 
 /*
  * Is C/C++ absolute value functions is absolute mess.
@@ -29,4 +30,10 @@ inline long double mod<long double>(long double a)
 {
     return fabsl(a);
 };
+
+template <typename real>
+inline real mod(std::complex<real> a)
+{
+    return std::hypot(a.real(), a.imag());
+};
 } // namespace cmp
\ No newline at end of file
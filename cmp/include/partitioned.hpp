@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cfenv>
+#include <cstdint>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+#include "transport.hpp"
+#include "tridiagonal.hpp"
+
+/*
+ * Domain decomposed solve of one system split between several processes.
+ *
+ * Each process owns a partition of consecutive rows, at least 2 of them. Partitions are ordered by rank.
+ * Local arrays follow `tridiagonal.hpp` convention, except that `a[0]` and `c[n - 1]` couple partition
+ * with its neighbours. They are padding only for the first and the last partition.
+ *
+ * Algorithm:
+ *  1. Interior rows [1, n - 2] of partition are solved locally for 3 right parts at once, expressing
+ *     interior as x[i] = y[i] + u[i] * f + v[i] * l, where f = x[0] and l = x[n - 1].
+ *  2. First and last rows of all partitions form a reduced tridiagonal system of 2 * size unknowns
+ *     (f0, l0, f1, l1, ...). Each process sends its 2 rows, and solves reduced system by itself.
+ *  3. Interior is fixed up with f and l.
+ *
+ * So there is only one exchange of `exchange_size()` bytes per solve.
+ * Like in `solve(...)`, initialy `x` is `d` and reused, everything else is preserved.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class partitioned_tridiagonal_matrix_solver
+{
+public:
+    // `n` is number of rows in partition of this process.
+    partitioned_tridiagonal_matrix_solver(transport& exchange, size_t n)
+        : transport_(exchange)
+        , interior_(3 * (n - 2))
+        , r_(n - 2)
+        , a_(2 * exchange.size())
+        , b_(2 * exchange.size())
+        , c_(2 * exchange.size())
+        , x_(2 * exchange.size())
+        , records_(record * exchange.size())
+    {
+        if constexpr (debug()) {
+            assert(n >= 2 && "Partition needs at least 2 rows!");
+        }
+    }
+
+    template <typename allocator_t>
+    void solve(
+        array<real, allocator_t>& x,
+        const array<real, allocator_t>& a,
+        const array<real, allocator_t>& b,
+        const array<real, allocator_t>& c)
+    {
+        const size_t n = x.size();
+        const size_t m = n - 2;
+
+        if constexpr (debug()) {
+            assert(3 * m == interior_.size());
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
+        }
+
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        // 1. Interior with 3 right parts: d, coupling with f and coupling with l.
+        if (m > 0) {
+            for (size_t i = 0; i < m; ++i) {
+                interior_[3 * i + 0] = x[i + 1];
+                interior_[3 * i + 1] = real(0);
+                interior_[3 * i + 2] = real(0);
+            }
+            interior_[1]         = -a[1];
+            interior_[3 * m - 1] = -c[n - 2];
+
+            tridiagonal_matrix_solver<real>::solve(
+                m, 3, interior_.data(), a.data() + 2, b.data() + 1, c.data() + 1, r_.data());
+        }
+
+        // 2. Reduced system rows.
+        real y;
+        real u;
+        real v;
+        real send[record];
+
+        coefficients(1, n, y, u, v);
+        send[0] = a[0];
+        send[1] = b[0] + c[0] * u;
+        send[2] = c[0] * v;
+        send[3] = x[0] - c[0] * y;
+
+        coefficients(n - 2, n, y, u, v);
+        send[4] = a[n - 1] * u;
+        send[5] = b[n - 1] + a[n - 1] * v;
+        send[6] = c[n - 1];
+        send[7] = x[n - 1] - a[n - 1] * y;
+
+        send[8] = std::fetestexcept(FE_DIVBYZERO) ? real(0) : real(1);
+
+        transport_.allgather(send, records_.data(), sizeof(send));
+
+        good_ = true;
+        for (size_t p = 0; p < transport_.size(); ++p) {
+            const real* restrict row = records_.data() + p * record;
+
+            a_[2 * p]     = row[0];
+            b_[2 * p]     = row[1];
+            c_[2 * p]     = row[2];
+            x_[2 * p]     = row[3];
+            a_[2 * p + 1] = row[4];
+            b_[2 * p + 1] = row[5];
+            c_[2 * p + 1] = row[6];
+            x_[2 * p + 1] = row[7];
+
+            if (row[8] < real(1)) {
+                good_ = false;
+            }
+        }
+
+        if (!good_) {
+            return;
+        }
+
+        // Reduced rows may be of any scale, so there is no determinant pre-check, only the sweep itself.
+        // `c_` is rebuilt every solve, so it is reused as `r`.
+        std::feclearexcept(FE_ALL_EXCEPT);
+        tridiagonal_matrix_solver<real>::solve(x_.size(), x_.data(), a_.data() + 1, b_.data(), c_.data());
+        if (std::fetestexcept(FE_DIVBYZERO | FE_INVALID)) {
+            good_ = false;
+            return;
+        }
+
+        // 3. Fix up.
+        const real f = x_[2 * transport_.rank()];
+        const real l = x_[2 * transport_.rank() + 1];
+
+        x[0]     = f;
+        x[n - 1] = l;
+        for (size_t i = 0; i < m; ++i) {
+            x[i + 1] = interior_[3 * i] + interior_[3 * i + 1] * f + interior_[3 * i + 2] * l;
+        }
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+    // Bytes sent by each process per solve, transport capacity must be at least this.
+    static constexpr size_t exchange_size()
+    {
+        return sizeof(real) * record;
+    }
+
+private:
+    // Row `i` of partition as x[i] = y + u * f + v * l.
+    void forceinline coefficients(size_t i, size_t n, real& y, real& u, real& v) const
+    {
+        if (i == 0) {
+            y = real(0);
+            u = real(1);
+            v = real(0);
+        } else if (i == n - 1) {
+            y = real(0);
+            u = real(0);
+            v = real(1);
+        } else {
+            y = interior_[3 * (i - 1) + 0];
+            u = interior_[3 * (i - 1) + 1];
+            v = interior_[3 * (i - 1) + 2];
+        }
+    }
+
+    // 2 rows of (a, b, c, d) and local status.
+    static constexpr size_t record = 9;
+
+    transport& transport_;
+
+    array<real> interior_;
+    array<real> r_;
+
+    array<real> a_;
+    array<real> b_;
+    array<real> c_;
+    array<real> x_;
+    array<real> records_;
+
+    bool good_{false};
+};
+} // namespace cmp
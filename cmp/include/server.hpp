@@ -0,0 +1,183 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "array.hpp"
+#include "debug.hpp"
+
+/*
+ * Solve server: long running process with warm solvers, serving systems over a Unix domain socket.
+ *
+ * Framing, native byte order, same machine only:
+ *     request:  `frame_header`, then a[n], b[n], c[n], d[n] of `precision` bytes reals
+ *     response: `frame_header` with `status`, then x[n] when status is `ok`
+ * Arrays follow `tridiagonal.hpp` convention, `a[0]` & `c[n - 1]` are padding. Responses carry `id` of the
+ * request, so a connection may pipeline many requests. Responses of one connection may come out of order.
+ *
+ * Systems up to `batch_rows` rows are not solved at once. They are coalesced with other requests of the same
+ * size & precision, from any connection, and solved together by interleaved kernel, until `max_batch` of them
+ * are pending or the oldest one waited for `budget_us`. Bigger systems are solved right away.
+ *
+ * System is `bad_system`, when the sweep divides by zero (see `solve_interleaved(...)`), so result does not
+ * depend on batching. Malformed frame is answered with `bad_request` and connection is closed.
+ *
+ * All buffers are allocated at start, server is a single thread around `poll`.
+ */
+
+namespace cmp
+{
+
+enum class frame_status : uint16_t
+{
+    ok,
+    bad_system,
+    bad_request,
+};
+
+struct frame_header {
+    static constexpr uint32_t signature = 0x534d4454; // "TDMS"
+
+    uint32_t magic;
+    uint16_t precision;
+    uint16_t status;
+    uint32_t n;
+    uint32_t reserved;
+    uint64_t id;
+};
+
+static_assert(sizeof(frame_header) == 24);
+
+struct server_config {
+    const char* path{"thomas.sock"};
+
+    size_t max_n{1 << 14};
+    size_t max_connections{32};
+
+    // Systems of at most `batch_rows` rows are batched, `max_groups` sizes at a time.
+    size_t batch_rows{256};
+    size_t max_batch{64};
+    size_t max_groups{8};
+    uint64_t budget_us{200};
+};
+
+struct server_stats {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+class solve_server
+{
+public:
+    explicit solve_server(const server_config& config);
+
+    ~solve_server();
+
+    solve_server(const solve_server&) = delete;
+
+    solve_server& operator=(const solve_server&) = delete;
+
+    // Binds & listens, false on failure (see `errno`).
+    bool listen();
+
+    // Serves until `stop()`.
+    void run();
+
+    // Safe from other threads and from signal handlers.
+    void stop();
+
+    // Solves done so far: `batches` counts interleaved solves, a big system is a batch of 1.
+    const server_stats& stats() const;
+
+private:
+    struct state;
+
+    server_config config_;
+    std::atomic<bool> stopping_{false};
+    state* state_{nullptr};
+
+    server_stats stats_;
+};
+
+/*
+ * Blocking client for `solve_server`.
+ */
+
+class solve_client
+{
+public:
+    explicit solve_client(const char* path);
+
+    ~solve_client();
+
+    solve_client(const solve_client&) = delete;
+
+    solve_client& operator=(const solve_client&) = delete;
+
+    bool connected() const
+    {
+        return fd_ >= 0;
+    }
+
+    // Sends request without waiting for response.
+    template <typename real>
+    bool submit(uint64_t id, const array<real>& a, const array<real>& b, const array<real>& c, const array<real>& d)
+    {
+        if constexpr (debug()) {
+            assert(a.size() == d.size());
+            assert(b.size() == d.size());
+            assert(c.size() == d.size());
+        }
+
+        frame_header header{frame_header::signature, sizeof(real), 0, uint32_t(d.size()), 0, id};
+
+        return write(&header, sizeof(header)) && write(a.data(), sizeof(real) * a.size()) &&
+               write(b.data(), sizeof(real) * b.size()) && write(c.data(), sizeof(real) * c.size()) &&
+               write(d.data(), sizeof(real) * d.size());
+    }
+
+    // Waits for the next response, `x` must be of its size. `bad_request` also reports a broken connection.
+    template <typename real>
+    frame_status receive(uint64_t& id, array<real>& x)
+    {
+        frame_header header;
+        if (!read(&header, sizeof(header)) || header.magic != frame_header::signature) {
+            return frame_status::bad_request;
+        }
+
+        id = header.id;
+
+        auto status = frame_status(header.status);
+        if (status != frame_status::ok) {
+            return status;
+        }
+
+        if (header.n != x.size() || header.precision != sizeof(real) || !read(x.data(), sizeof(real) * x.size())) {
+            return frame_status::bad_request;
+        }
+
+        return frame_status::ok;
+    }
+
+    // Initialy `x` is `d` and reused, as in `tridiagonal_matrix_solver::solve(...)`.
+    template <typename real>
+    frame_status solve(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        uint64_t id = next_++;
+        if (!submit(id, a, b, c, x)) {
+            return frame_status::bad_request;
+        }
+
+        uint64_t got;
+        return receive(got, x);
+    }
+
+private:
+    bool write(const void* data, size_t bytes);
+    bool read(void* data, size_t bytes);
+
+    int fd_{-1};
+    uint64_t next_{0};
+};
+} // namespace cmp
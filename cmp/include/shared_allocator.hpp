@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+/*
+ * Allocator for memory shared between processes.
+ *
+ * Memory is mapped as shared anonymous mapping, so it is visible to all processes forked after allocation.
+ * Use it as `array<T, shared_allocator>`. Mapping is zero filled and page granular, so this is
+ * only for big long living buffers.
+ */
+
+namespace cmp
+{
+
+class shared_allocator
+{
+public:
+    static void* allocate(size_t size);
+
+    static void deallocate(void* ptr);
+};
+} // namespace cmp
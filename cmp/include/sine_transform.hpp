@@ -0,0 +1,244 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <utility>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+#include "restrict.hpp"
+
+/*
+ * Discrete sine transform (DST-I), no external FFT needed:
+ *
+ *     X[k] = sum(x[i] * sin(pi * (i + 1) * (k + 1) / (n + 1))), i, k in [0, n)
+ *
+ * It is its own inverse up to `scale()`, x = scale() * DST(DST(x)).
+ *
+ * Line is extended to odd sequence of length m = 2 * (n + 1), so DST is imaginary part of its FFT.
+ * Odd real sequence has purely imaginary FFT, so 2 lines go through one complex FFT: one in real part,
+ * one in imaginary part. FFT is iterative radix-2 when m is a power of 2, otherwise Bluestein's chirp-z
+ * over radix-2 FFT of size at least 2 * m - 1. Tables & scratch are allocated in ctor.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class sine_transform
+{
+public:
+    explicit sine_transform(size_t n)
+        : n_(n)
+        , m_(2 * (n + 1))
+        , size_(std::has_single_bit(m_) ? m_ : std::bit_ceil(2 * m_ - 1))
+        , cos_(size_ / 2)
+        , sin_(size_ / 2)
+        , reversed_(size_)
+        , re_(size_)
+        , im_(size_)
+        , chirp_re_(size_ != m_ ? m_ : 0)
+        , chirp_im_(size_ != m_ ? m_ : 0)
+        , filter_re_(size_ != m_ ? size_ : 0)
+        , filter_im_(size_ != m_ ? size_ : 0)
+    {
+        for (size_t k = 0; k < size_ / 2; ++k) {
+            double angle = -2.0 * std::numbers::pi * double(k) / double(size_);
+            cos_[k]      = real(std::cos(angle));
+            sin_[k]      = real(std::sin(angle));
+        }
+
+        const size_t bits = size_t(std::countr_zero(size_));
+        for (size_t i = 0; i < size_; ++i) {
+            size_t r = 0;
+            for (size_t b = 0; b < bits; ++b) {
+                r = (r << 1) | ((i >> b) & 1);
+            }
+            reversed_[i] = r;
+        }
+
+        if (size_ != m_) {
+            bluestein();
+        }
+    }
+
+    // Transforms lines `first` & `second` in place, `second` may be nullptr.
+    void apply(real* restrict first, real* restrict second)
+    {
+        const size_t n = n_;
+        const size_t m = m_;
+
+        re_[0]     = real(0);
+        im_[0]     = real(0);
+        re_[n + 1] = real(0);
+        im_[n + 1] = real(0);
+
+        for (size_t i = 0; i < n; ++i) {
+            real x = first[i];
+            real y = second != nullptr ? second[i] : real(0);
+
+            re_[i + 1]     = x;
+            im_[i + 1]     = y;
+            re_[m - 1 - i] = -x;
+            im_[m - 1 - i] = -y;
+        }
+
+        if (size_ == m) {
+            fft(re_.data(), im_.data());
+        } else {
+            chirp_z();
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            first[k] = -im_[k + 1] * real(0.5);
+            if (second != nullptr) {
+                second[k] = re_[k + 1] * real(0.5);
+            }
+        }
+    }
+
+    // Transforms `count` consecutive lines of length n.
+    void apply_lines(real* restrict lines, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 1 < count; i += 2) {
+            apply(lines + i * n_, lines + (i + 1) * n_);
+        }
+        if (i < count) {
+            apply(lines + i * n_, nullptr);
+        }
+    }
+
+    real scale() const
+    {
+        return real(2) / real(n_ + 1);
+    }
+
+    size_t size() const
+    {
+        return n_;
+    }
+
+private:
+    // In place forward FFT of size `size_`.
+    void fft(real* restrict re, real* restrict im) const
+    {
+        const size_t size = size_;
+
+        for (size_t i = 0; i < size; ++i) {
+            size_t j = reversed_[i];
+            if (i < j) {
+                std::swap(re[i], re[j]);
+                std::swap(im[i], im[j]);
+            }
+        }
+
+        for (size_t half = 1; half < size; half *= 2) {
+            const size_t stride = size / (2 * half);
+
+            for (size_t start = 0; start < size; start += 2 * half) {
+                for (size_t k = 0; k < half; ++k) {
+                    real wr = cos_[k * stride];
+                    real wi = sin_[k * stride];
+
+                    size_t p = start + k;
+                    size_t q = p + half;
+
+                    real tr = re[q] * wr - im[q] * wi;
+                    real ti = re[q] * wi + im[q] * wr;
+
+                    re[q] = re[p] - tr;
+                    im[q] = im[p] - ti;
+                    re[p] += tr;
+                    im[p] += ti;
+                }
+            }
+        }
+    }
+
+    // Chirp w[i] = exp(-i pi i^2 / m) and FFT of its conjugate, wrapped around.
+    void bluestein()
+    {
+        const size_t m = m_;
+
+        for (size_t i = 0; i < size_; ++i) {
+            filter_re_[i] = real(0);
+            filter_im_[i] = real(0);
+        }
+
+        for (size_t i = 0; i < m; ++i) {
+            // i^2 mod 2m keeps angle small, so it is exact for big m.
+            double angle = -std::numbers::pi * double((i * i) % (2 * m)) / double(m);
+            chirp_re_[i] = real(std::cos(angle));
+            chirp_im_[i] = real(std::sin(angle));
+
+            filter_re_[i] = chirp_re_[i];
+            filter_im_[i] = -chirp_im_[i];
+            if (i > 0) {
+                filter_re_[size_ - i] = chirp_re_[i];
+                filter_im_[size_ - i] = -chirp_im_[i];
+            }
+        }
+
+        fft(filter_re_.data(), filter_im_.data());
+    }
+
+    // Length m FFT of `re_` & `im_` as convolution with chirp.
+    void chirp_z()
+    {
+        const size_t m    = m_;
+        const size_t size = size_;
+
+        real* restrict re = re_.data();
+        real* restrict im = im_.data();
+
+        for (size_t i = 0; i < m; ++i) {
+            real r = re[i] * chirp_re_[i] - im[i] * chirp_im_[i];
+            im[i]  = re[i] * chirp_im_[i] + im[i] * chirp_re_[i];
+            re[i]  = r;
+        }
+        for (size_t i = m; i < size; ++i) {
+            re[i] = real(0);
+            im[i] = real(0);
+        }
+
+        fft(re, im);
+
+        // Pointwise product, conjugated, so inverse FFT is forward FFT again.
+        for (size_t i = 0; i < size; ++i) {
+            real r = re[i] * filter_re_[i] - im[i] * filter_im_[i];
+            im[i]  = -(re[i] * filter_im_[i] + im[i] * filter_re_[i]);
+            re[i]  = r;
+        }
+
+        fft(re, im);
+
+        const real inverse = real(1) / real(size);
+        for (size_t i = 0; i < m; ++i) {
+            real cr = re[i] * inverse;
+            real ci = -im[i] * inverse;
+
+            re[i] = cr * chirp_re_[i] - ci * chirp_im_[i];
+            im[i] = cr * chirp_im_[i] + ci * chirp_re_[i];
+        }
+    }
+
+    size_t n_;
+    size_t m_;
+    size_t size_;
+
+    array<real> cos_;
+    array<real> sin_;
+    array<size_t> reversed_;
+    array<real> re_;
+    array<real> im_;
+
+    array<real> chirp_re_;
+    array<real> chirp_im_;
+    array<real> filter_re_;
+    array<real> filter_im_;
+};
+} // namespace cmp
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cfenv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "tridiagonal.hpp"
+
+/*
+ * Batched cubic splines.
+ *
+ * Knots must be strictly increasing, there are at least 2 of them.
+ *
+ * All splines in the batch share the same knots `t`, so they share the same tridiagonal matrix
+ * and are solved together with batch kernel of `tridiagonal_matrix_solver`. Rows scale with knot
+ * intervals, so determinant underflows for ordinary knot counts and there is no determinant check,
+ * only floating point enviroment, as in `helmholtz.hpp`.
+ *
+ * Values are interleaved as in `solve_batch(...)`: `y[i * count + k]` is value of spline `k` at knot `i`.
+ * Evaluation results are interleaved the same way: `out[j * count + k]` is spline `k` at query `j`.
+ *
+ * Spline is stored as knot values and second derivatives `m`. Fit assembles the system straight into
+ * preallocated `a`, `b`, `c` and `m` in the same pass that copies values, there is no memory management
+ * after construction.
+ *
+ * Interval lookup:
+ *     Range of knots is split into uniform cells not wider than the smallest knot interval
+ *     (up to `lookup_cells(n)` cells). Each cell caches index of the knot interval at its left edge.
+ *     Query is mapped into cell with one multiplication and then corrected with branchless binary search
+ *     over knots inside the cell. Number of steps is fixed per fit, bit width of the most knots in one
+ *     cell, so it stays logarithmic for clustered knots, and there is no data dependent branching per query.
+ *     Queries outside of the knots range are extrapolated by the outermost polynomials.
+ *     Queries must not be NaN.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class cubic_spline_batch
+{
+public:
+    cubic_spline_batch(size_t n, size_t count)
+        : n_(n)
+        , count_(count)
+        , t_(n)
+        , y_(n * count)
+        , m_(n * count)
+        , a_(n)
+        , b_(n)
+        , c_(n)
+        , r_(n)
+        , upper_(n - 1)
+        , lookup_(lookup_cells(n))
+    {
+        if constexpr (debug()) {
+            assert(n >= 2 && "Spline needs at least 2 knots!");
+        }
+    }
+
+    // Natural spline: second derivatives are 0 at the ends.
+    void fit(const array<real>& t, const array<real>& y)
+    {
+        assemble(t, y);
+
+        b_[0]      = real(1);
+        c_[0]      = real(0);
+        a_[n_ - 1] = real(0);
+        b_[n_ - 1] = real(1);
+
+        for (size_t k = 0; k < count_; ++k) {
+            m_[k]                     = real(0);
+            m_[(n_ - 1) * count_ + k] = real(0);
+        }
+
+        solve();
+    }
+
+    // Clamped spline: `left[k]` & `right[k]` are first derivatives of spline `k` at the ends.
+    void fit(const array<real>& t, const array<real>& y, const array<real>& left, const array<real>& right)
+    {
+        if constexpr (debug()) {
+            assert(left.size() == count_);
+            assert(right.size() == count_);
+        }
+
+        assemble(t, y);
+
+        real h0 = t_[1] - t_[0];
+        real hn = t_[n_ - 1] - t_[n_ - 2];
+
+        b_[0]      = real(2) * h0;
+        c_[0]      = h0;
+        a_[n_ - 1] = hn;
+        b_[n_ - 1] = real(2) * hn;
+
+        const real* restrict y0 = y_.data();
+        const real* restrict y1 = y_.data() + count_;
+        const real* restrict yl = y_.data() + (n_ - 2) * count_;
+        const real* restrict yn = y_.data() + (n_ - 1) * count_;
+        real* restrict m0       = m_.data();
+        real* restrict mn       = m_.data() + (n_ - 1) * count_;
+
+        for (size_t k = 0; k < count_; ++k) {
+            m0[k] = real(6) * ((y1[k] - y0[k]) / h0 - left[k]);
+            mn[k] = real(6) * (right[k] - (yn[k] - yl[k]) / hn);
+        }
+
+        solve();
+    }
+
+    void evaluate(const array<real>& q, array<real>& out) const
+    {
+        if constexpr (debug()) {
+            assert(out.size() == q.size() * count_);
+        }
+
+        const real* restrict t     = t_.data();
+        const real* restrict upper = upper_.data();
+        const size_t* restrict lut = lookup_.data();
+        const real last_cell       = real(cells_ - 1);
+        const size_t last          = n_ - 2;
+
+        for (size_t j = 0; j < q.size(); ++j) {
+            real p = q[j];
+
+            real s   = std::clamp((p - t[0]) * inv_cell_, real(0), last_cell);
+            size_t i = lut[size_t(s)];
+            for (size_t half = top_; half > 0; half /= 2) {
+                i += p >= upper[std::min(i + half - 1, last)] ? half : 0;
+            }
+
+            real h  = t[i + 1] - t[i];
+            real aa = (t[i + 1] - p) / h;
+            real bb = real(1) - aa;
+            real ca = (aa * aa * aa - aa) * h * h / real(6);
+            real cb = (bb * bb * bb - bb) * h * h / real(6);
+
+            const real* restrict yi = y_.data() + i * count_;
+            const real* restrict mi = m_.data() + i * count_;
+            real* restrict res      = out.data() + j * count_;
+
+            for (size_t k = 0; k < count_; ++k) {
+                res[k] = aa * yi[k] + bb * yi[k + count_] + ca * mi[k] + cb * mi[k + count_];
+            }
+        }
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+    size_t size() const
+    {
+        return n_;
+    }
+
+    size_t count() const
+    {
+        return count_;
+    }
+
+    // Upper bound for lookup table size. Cells are never narrower than 1 / 4 of the mean knot interval.
+    static size_t lookup_cells(size_t n)
+    {
+        return 4 * n;
+    }
+
+private:
+    void solve()
+    {
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        tridiagonal_matrix_solver<real>::solve(
+            n_, count_, m_.data(), a_.data() + 1, b_.data(), c_.data(), r_.data());
+
+        good_ = !std::fetestexcept(FE_DIVBYZERO | FE_INVALID);
+    }
+
+    // Fills interior rows of the system, copies knots & values and builds interval lookup.
+    void assemble(const array<real>& t, const array<real>& y)
+    {
+        if constexpr (debug()) {
+            assert(t.size() == n_);
+            assert(y.size() == n_ * count_);
+        }
+
+        memcpy(t_.data(), t.data(), sizeof(real) * n_);
+
+        // Values are copied row ahead of the right hand side that reads them.
+        memcpy(y_.data(), y.data(), sizeof(real) * 2 * count_);
+
+        // Padding, see `tridiagonal.hpp` convention.
+        a_[0]      = real(0);
+        c_[n_ - 1] = real(0);
+
+        for (size_t i = 1; i + 1 < n_; ++i) {
+            real hl = t_[i] - t_[i - 1];
+            real hr = t_[i + 1] - t_[i];
+
+            a_[i] = hl;
+            b_[i] = real(2) * (hl + hr);
+            c_[i] = hr;
+
+            const real* restrict yl = y_.data() + (i - 1) * count_;
+            const real* restrict yc = y_.data() + i * count_;
+            const real* restrict yr = y.data() + (i + 1) * count_;
+            real* restrict copy     = y_.data() + (i + 1) * count_;
+            real* restrict m        = m_.data() + i * count_;
+
+            for (size_t k = 0; k < count_; ++k) {
+                copy[k] = yr[k];
+                m[k]    = real(6) * ((yr[k] - yc[k]) / hr - (yc[k] - yl[k]) / hl);
+            }
+        }
+
+        build_lookup();
+    }
+
+    void build_lookup()
+    {
+        real range = t_[n_ - 1] - t_[0];
+        real hmin  = range;
+
+        for (size_t i = 0; i + 1 < n_; ++i) {
+            hmin      = std::min(hmin, t_[i + 1] - t_[i]);
+            upper_[i] = t_[i + 1];
+        }
+        upper_[n_ - 2] = std::numeric_limits<real>::infinity();
+
+        real cells = std::ceil(range / hmin);
+        cells_     = std::min(lookup_cells(n_), size_t(std::max(cells, real(1))));
+        inv_cell_  = real(cells_) / range;
+
+        // Interval index at the left edge of each cell, and worst number of knots inside one cell.
+        size_t i     = 0;
+        size_t steps = 0;
+        for (size_t j = 0; j < cells_; ++j) {
+            real left  = t_[0] + real(j) / inv_cell_;
+            real right = t_[0] + real(j + 1) / inv_cell_;
+
+            while (i + 2 < n_ && t_[i + 1] < left) {
+                ++i;
+            }
+            lookup_[j] = i;
+
+            size_t k = i;
+            while (k + 2 < n_ && t_[k + 1] <= right) {
+                ++k;
+            }
+            steps = std::max(steps, k - i);
+        }
+
+        // Search steps of `top_`, `top_ / 2`, ..., 1 reach any of `steps` following intervals.
+        top_ = steps > 0 ? std::bit_floor(steps) : 0;
+    }
+
+    size_t n_;
+    size_t count_;
+
+    array<real> t_;
+    array<real> y_;
+    array<real> m_;
+
+    array<real> a_;
+    array<real> b_;
+    array<real> c_;
+    array<real> r_;
+
+    array<real> upper_;
+    array<size_t> lookup_;
+    size_t cells_{1};
+    size_t top_{0};
+    real inv_cell_{1};
+
+    bool good_{false};
+};
+} // namespace cmp
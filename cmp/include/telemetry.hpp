@@ -0,0 +1,139 @@
+#pragma once
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+#include "forceinline.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Solve telemetry.
+ *
+ * Solver with a call site attached (see `tridiagonal_matrix_solver::trace(...)`) records every solve:
+ * duration in CPU ticks, system size, mode and outcome. Records go into a per thread lock-free ring,
+ * so recording is a couple of stores. Full ring drops records and counts them.
+ *
+ * `snapshot(...)` drains all rings into per site aggregates (HDR-style latency histogram, system size
+ * histogram and counters) and copies them out. It takes a lock, but only against other snapshots,
+ * solvers are never paused. Somebody has to take snapshots often enough, or records will be dropped.
+ *
+ * Ticks are TSC on x86, virtual counter on ARM and steady clock nanoseconds elsewhere.
+ * Conversion to nanoseconds is calibrated once, at first `ticks_per_second()`.
+ */
+
+namespace cmp
+{
+
+enum class solve_mode : uint8_t
+{
+    fast,
+    normal,
+    slow,
+    incremental,
+    batch,
+    blocked,
+    count,
+};
+
+/*
+ * Log-linear histogram: 16 linear sub buckets for every power of 2, so relative error is below 1/16.
+ */
+
+class histogram
+{
+public:
+    void add(uint64_t value)
+    {
+        ++counts_[index(value)];
+        ++total_;
+    }
+
+    void add(const histogram& other);
+
+    uint64_t total() const
+    {
+        return total_;
+    }
+
+    // Smallest bucket bound, such that at least `p` (in [0, 1]) of values are below it.
+    uint64_t percentile(double p) const;
+
+    static constexpr size_t sub_bits = 4;
+    static constexpr size_t sub      = size_t(1) << sub_bits;
+    static constexpr size_t buckets  = (64 - sub_bits + 1) * sub;
+
+    static size_t forceinline index(uint64_t value)
+    {
+        if (value < sub) {
+            return size_t(value);
+        }
+
+        size_t shift = size_t(std::bit_width(value)) - 1 - sub_bits;
+        return (shift + 1) * sub + size_t((value >> shift) & (sub - 1));
+    }
+
+    // Upper bound of values in bucket.
+    static uint64_t bound(size_t index);
+
+private:
+    uint64_t counts_[buckets]{};
+    uint64_t total_{0};
+};
+
+struct site_stats {
+    const char* name{nullptr};
+
+    uint64_t calls[size_t(solve_mode::count)]{};
+    uint64_t failures[size_t(solve_mode::count)]{};
+
+    histogram latency;
+
+    // Bucket `i` counts systems with bit width of `n` equal to `i`.
+    uint64_t sizes[65]{};
+};
+
+struct telemetry_snapshot {
+    static constexpr size_t max_sites = 32;
+
+    site_stats sites[max_sites];
+    size_t count{0};
+    uint64_t dropped{0};
+};
+
+class telemetry
+{
+public:
+    // Registers call site, `name` must outlive telemetry. Returns 0 (tracing disabled) when out of sites.
+    static uint16_t site(const char* name);
+
+    static void record(uint16_t site, solve_mode mode, size_t n, uint64_t ticks, bool good);
+
+    // Snapshot is big, so it is filled in place.
+    static void snapshot(telemetry_snapshot& out);
+
+    // Human readable export of snapshot: counters, latency percentiles and sizes for each site.
+    static void dump(std::ostream& stream);
+
+    static double ticks_per_second();
+
+    static uint64_t forceinline ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t value;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+        return value;
+#else
+        return uint64_t(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+#endif
+    }
+};
+} // namespace cmp
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+#include "array.hpp"
+#include "shared_allocator.hpp"
+
+/*
+ * Communication between processes solving one distributed system.
+ *
+ * Solvers only need to gather a small fixed size record from every process, so this is the whole interface.
+ * Network transport may be added later by implementing `transport`.
+ */
+
+namespace cmp
+{
+
+class transport
+{
+public:
+    virtual ~transport() = default;
+
+    virtual size_t rank() const = 0;
+
+    virtual size_t size() const = 0;
+
+    // Every process sends `bytes` from `send`, and receives records of all processes ordered by rank into `recv`.
+    // Acts as a barrier.
+    virtual void allgather(const void* send, void* recv, size_t bytes) = 0;
+};
+
+/*
+ * Processes on the same machine, communicating through shared memory.
+ *
+ * Transport have to be created before `fork()`, then each process calls `join(rank)`.
+ * Barrier is a futex on Linux, elsewhere processes just yield while waiting.
+ */
+
+class shared_memory_transport : public transport
+{
+public:
+    // `size` processes exchanging records up to `capacity` bytes.
+    shared_memory_transport(size_t size, size_t capacity);
+
+    shared_memory_transport(const shared_memory_transport&) = delete;
+
+    shared_memory_transport& operator=(const shared_memory_transport&) = delete;
+
+    void join(size_t rank);
+
+    size_t rank() const override;
+
+    size_t size() const override;
+
+    void allgather(const void* send, void* recv, size_t bytes) override;
+
+private:
+    void barrier();
+
+    size_t rank_;
+    size_t size_;
+    size_t capacity_;
+
+    // Records are double buffered, so one barrier per exchange is enough.
+    size_t generation_;
+
+    array<unsigned char, shared_allocator> segment_;
+};
+} // namespace cmp
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cfenv>
+#include <cmath>
 #include <cstdint>
 
 #include "array.hpp"
 #include "debug.hpp"
+#include "dispatch.hpp"
+#include "expression.hpp"
 #include "forceinline.hpp"
 #include "isclose.hpp"
 #include "restrict.hpp"
+#include "telemetry.hpp"
 
 /*
  * Convention:
@@ -52,10 +57,40 @@
  *  3. Use `solve_slow(...)`
  *     This preserves everything. Additional space have to be allocated as in `solve(...)`
  *     and `d` vector must be supplied separatly.
+ *     `d` may also be an expression of arrays (see `expression.hpp`), then it is never materialized.
+ *  4. Use `solve_incremental(...)`
+ *     Preserves everything as `solve_slow(...)`, but also keeps forward sweep state (`r` and swept `d`)
+ *     between calls. When only rows [first, last] of `a`, `b`, `c` or `d` changed since previous call,
+ *     elimination restarts from `first` and both sweeps stop once update decayed below tolerance,
+ *     relative to each entry, so scale of the solution does not matter.
+ *     Update decays only when |r| < 1, so matrix must be diagonally dominant, otherwise early stop
+ *     may return stale rows. `x` must hold previous solution. Reusable space have to be at least
+ *     `incremental_reusable(n)`.
+ *
+ *  5. Use `solve_batch(...)`
+ *     Many right parts with the same matrix. Right parts are interleaved in `x`: `x[i * count + k]` is
+ *     row `i` of system `k`, so inner loop runs over systems and vectorizes. `c` is preserved,
+ *     reusable space have to be allocated as in `solve(...)`.
+ *
+ *  6. Use `solve_blocked(...)`
+ *     Same as `solve(...)`, but for systems far beyond last level cache. Forward sweep keeps `r` only at
+ *     block boundaries, backward sweep recomputes `r` of each block while the block is still in cache.
+ *     This trades 1 division per row for not writing & reading back whole `r` from memory.
+ *     Reusable space have to be at least `blocked_reusable(n)`.
  *
  * Check for division by 0 every time is kinda stupud, this messing up prefetch & speculative execution.
  * So here I'm using floating point enviroment exceptions. This is a client responsibility to check
  * for `good()` after `solve(...)` to check for success.
+ *
+ * Kernels of `solve_fast(...)`, `solve(...)`, `solve_slow(...)`, `solve_batch(...)` and determinant check
+ * are compiled for several ISA and picked at runtime for this CPU, see `dispatch.hpp`.
+ */
+
+/*
+ * Linking notes:
+ *
+ * This header is not self-contained, link with `cmplib`. Besides `allocator` of `array.hpp`, it needs
+ * selected ISA level (`dispatch.cpp`) and `telemetry::record(...)` (`telemetry.cpp`).
  */
 
 /*
@@ -94,18 +129,24 @@ public:
         if constexpr (debug()) {
             assert(x.size() == a.size());
             assert(x.size() == b.size());
-            assert(x.size() == c.size());
+            // `c` is reused, so it may be a longer scratch.
+            assert(x.size() <= c.size());
         }
 
+        const uint64_t start = begin();
+
         if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::fast, x.size());
             return;
         }
 
         prepare();
 
-        solve(x.size(), x.data(), a.data(), b.data(), c.data());
+        dispatch<static_cast<fast_kernel>(&solve)>(x.size(), x.data(), a.data() + 1, b.data(), c.data());
 
         check();
+
+        end(start, solve_mode::fast, x.size());
     }
 
     void solve(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
@@ -117,15 +158,21 @@ public:
             assert(x.size() == c.size());
         }
 
+        const uint64_t start = begin();
+
         if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::normal, x.size());
             return;
         }
 
         prepare();
 
-        solve(x.size(), x.data(), a.data(), b.data(), c.data(), reusable_.data());
+        dispatch<static_cast<reusable_kernel>(&solve)>(
+            x.size(), x.data(), a.data() + 1, b.data(), c.data(), reusable_.data());
 
         check();
+
+        end(start, solve_mode::normal, x.size());
     }
 
     void
@@ -136,18 +183,171 @@ public:
             assert(x.size() == a.size());
             assert(x.size() == b.size());
             assert(x.size() == c.size());
+            assert(x.size() <= d.size());
+        }
+
+        const uint64_t start = begin();
+
+        if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::slow, x.size());
+            return;
+        }
+
+        prepare();
+
+        dispatch<static_cast<slow_kernel>(&solve)>(
+            x.size(), x.data(), a.data() + 1, b.data(), c.data(), d.data(), reusable_.data());
+
+        check();
+
+        end(start, solve_mode::slow, x.size());
+    }
+
+    // `d` is an expression (see `expression.hpp`), evaluated row by row inside the forward sweep.
+    // `x` must not appear in it.
+    template <expression E>
+    void solve_slow(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c, const E& d)
+    {
+        if constexpr (debug()) {
+            assert((x.size() <= reusable_.size()) && "Not enough reusable space for me!");
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
+            assert(x.size() <= d.size());
+        }
+
+        const uint64_t start = begin();
+
+        if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::slow, x.size());
+            return;
+        }
+
+        prepare();
+
+        solve(x.size(), x.data(), a.data() + 1, b.data(), c.data(), d, reusable_.data());
+
+        check();
+
+        end(start, solve_mode::slow, x.size());
+    }
+
+    void solve_incremental(
+        array<real>& x,
+        const array<real>& a,
+        const array<real>& b,
+        const array<real>& c,
+        const array<real>& d,
+        size_t first,
+        size_t last,
+        real tolerance = eps<real>())
+    {
+        if constexpr (debug()) {
+            assert((incremental_reusable(x.size()) <= reusable_.size()) && "Not enough reusable space for me!");
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
             assert(x.size() == d.size());
+            assert(first <= last && last < x.size());
+        }
+
+        const uint64_t start = begin();
+
+        // Saved state belongs to other system, so everything is dirty.
+        if (incremental_ != x.size()) {
+            first = 0;
+            last  = x.size() - 1;
         }
 
+        // Determinant is O(n) by itself, so here we are relying only on floating point enviroment.
+        prepare();
+
+        solve(
+            x.size(),
+            x.data(),
+            a.data() + 1,
+            b.data(),
+            c.data(),
+            d.data(),
+            reusable_.data(),
+            reusable_.data() + x.size(),
+            first,
+            last,
+            tolerance);
+
+        check();
+
+        incremental_ = good_ ? x.size() : 0;
+
+        end(start, solve_mode::incremental, x.size());
+    }
+
+    void
+    solve_batch(array<real>& x, size_t count, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        if constexpr (debug()) {
+            assert((a.size() <= reusable_.size()) && "Not enough reusable space for me!");
+            assert(x.size() == a.size() * count);
+            assert(a.size() == b.size());
+            assert(a.size() == c.size());
+        }
+
+        const uint64_t start = begin();
+
+        if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::batch, a.size());
+            return;
+        }
+
+        prepare();
+
+        dispatch<static_cast<batch_kernel>(&solve)>(
+            a.size(), count, x.data(), a.data() + 1, b.data(), c.data(), reusable_.data());
+
+        check();
+
+        end(start, solve_mode::batch, a.size());
+    }
+
+    void solve_blocked(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        if constexpr (debug()) {
+            assert((blocked_reusable(x.size()) <= reusable_.size()) && "Not enough reusable space for me!");
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
+        }
+
+        const uint64_t start = begin();
+
         if (!good_determinant(a, b, c)) {
+            end(start, solve_mode::blocked, x.size());
             return;
         }
 
         prepare();
 
-        solve(x.size(), x.data(), a.data(), b.data(), c.data(), d.data(), reusable_.data());
+        solve(
+            x.size(), x.data(), a.data() + 1, b.data(), c.data(), reusable_.data(), reusable_.data() + blocked_rows);
 
         check();
+
+        end(start, solve_mode::blocked, x.size());
+    }
+
+    // Block of `r` have to fit in L1/L2 together with the same rows of `a`, `b`, `c` & `x`.
+    static constexpr size_t blocked_rows = 4096;
+
+    // Blocked mode keeps block of `r` and one checkpoint per block.
+    static size_t blocked_reusable(size_t n)
+    {
+        return blocked_rows + (n + blocked_rows - 1) / blocked_rows;
+    }
+
+    // Incremental mode keeps both `r` and swept `d`.
+    static size_t incremental_reusable(size_t n)
+    {
+        return 2 * n;
     }
 
     bool good() const
@@ -155,11 +355,24 @@ public:
         return good_;
     }
 
+    // Attach telemetry call site (see `telemetry.hpp`), 0 disables tracing.
+    void trace(uint16_t site)
+    {
+        site_ = site;
+    }
+
 private:
+    // Overloads of raw kernels, as `dispatch<...>(...)` takes a function (see `dispatch.hpp`).
+    using fast_kernel     = void (*)(size_t, real*, const real*, const real*, real*);
+    using reusable_kernel = void (*)(size_t, real*, const real*, const real*, const real*, real*);
+    using slow_kernel     = void (*)(size_t, real*, const real*, const real*, const real*, const real*, real*);
+    using batch_kernel    = void (*)(size_t, size_t, real*, const real*, const real*, const real*, real*);
+
     void forceinline prepare()
     {
         std::feclearexcept(FE_ALL_EXCEPT);
-        good_ = true;
+        good_        = true;
+        incremental_ = 0;
     }
 
     void forceinline check()
@@ -169,11 +382,23 @@ private:
         }
     }
 
+    uint64_t forceinline begin() const
+    {
+        return site_ != 0 ? telemetry::ticks() : 0;
+    }
+
+    void forceinline end(uint64_t start, solve_mode mode, size_t n) const
+    {
+        if (site_ != 0) {
+            [[unlikely]] telemetry::record(site_, mode, n, telemetry::ticks() - start, good_);
+        }
+    }
+
     // Wery difficult to design a general algorithm for checking is matrix have a 0 determinant or not.
     // Here we proposing that this is another module responsibility to normalize input data.
     bool forceinline good_determinant(const array<real>& a, const array<real>& b, const array<real>& c)
     {
-        real det = determinant(a.size(), a.data(), b.data(), c.data());
+        real det = dispatch<&determinant>(a.size(), a.data(), b.data(), c.data());
 
         if (isclose(det, real(0))) {
             good_ = false;
@@ -185,7 +410,7 @@ private:
 
     // This function is kinda usless in case of matricies with small values.
     // But I think this realisation is beautefull (and fast), so I leave it.
-    real determinant(const size_t n, const real* restrict a, const real* restrict b, const real* restrict c)
+    static real determinant(const size_t n, const real* restrict a, const real* restrict b, const real* restrict c)
     {
         real f1;
         real f2;
@@ -209,6 +434,12 @@ private:
         return f2;
     }
 
+public:
+    // Raw kernels, for composing other solvers out of them. There are no checks here at all,
+    // floating point enviroment have to be handled by caller.
+    // `a` points to subdiagonal of row 1 (`a.data() + 1`). `solve(n, x, a, b, c)` and `solve(n, x, a, b, c, r)`
+    // never touch `c[n - 1]`, so they take n - 1 length off diagonals as is.
+
     static void forceinline solve(
         const size_t n,
         real* restrict x,
@@ -224,7 +455,6 @@ private:
         *x = *d / *b;
 
         for (i = 1; i < n; ++i) {
-            ++a;
             ++b;
             ++c;
             ++d;
@@ -234,6 +464,7 @@ private:
             ++r;
             *r = *c * w;
             *x = (*d - *a * *(x - 1)) * w;
+            ++a;
         }
 
         for (i = 1; i < n; ++i) {
@@ -243,19 +474,250 @@ private:
         }
     }
 
+    template <expression E>
     static void forceinline solve(
         const size_t n,
         real* restrict x,
         const real* restrict a,
         const real* restrict b,
         const real* restrict c,
+        const E& d,
         real* restrict r)
     {
-        *r = *c / *b;
-        *x = *x / *b;
+        r[0] = c[0] / b[0];
+        x[0] = d[0] / b[0];
 
         for (size_t i = 1; i < n; ++i) {
+            real w = real(1) / (b[i] - a[i - 1] * r[i - 1]);
+            r[i]   = c[i] * w;
+            x[i]   = (d[i] - a[i - 1] * x[i - 1]) * w;
+        }
+
+        for (size_t i = n - 1; i > 0; --i) {
+            x[i - 1] -= r[i - 1] * x[i];
+        }
+    }
+
+    // Sweep state of the previous call is in `r` & `y`, solution in `x`. Rows before `first` are valid,
+    // rows after `last` are identical to previous call, so their state stays valid once update vanished.
+    // `tolerance` is relative to magnitude of each entry.
+    static void forceinline solve(
+        const size_t n,
+        real* restrict x,
+        const real* restrict a,
+        const real* restrict b,
+        const real* restrict c,
+        const real* restrict d,
+        real* restrict r,
+        real* restrict y,
+        const size_t first,
+        const size_t last,
+        const real tolerance)
+    {
+        size_t i   = first;
+        size_t top = n - 1;
+
+        if (i == 0) {
+            r[0] = c[0] / b[0];
+            y[0] = d[0] / b[0];
+            ++i;
+        }
+
+        for (; i < n; ++i) {
+            real w  = real(1) / (b[i] - a[i - 1] * r[i - 1]);
+            real ri = c[i] * w;
+            real yi = (d[i] - a[i - 1] * y[i - 1]) * w;
+
+            bool settled = i > last && mod(ri - r[i]) <= tolerance * mod(ri) && mod(yi - y[i]) <= tolerance * mod(yi);
+
+            r[i] = ri;
+            y[i] = yi;
+
+            if (settled) {
+                top = i;
+                break;
+            }
+        }
+
+        // Rows after `top` are unchanged, so `x[top + 1]` is still a solution.
+        x[top] = top == n - 1 ? y[top] : y[top] - r[top] * x[top + 1];
+
+        for (i = top; i > 0; --i) {
+            real xi = y[i - 1] - r[i - 1] * x[i];
+
+            bool settled = i - 1 < first && mod(xi - x[i - 1]) <= tolerance * mod(xi);
+
+            x[i - 1] = xi;
+
+            if (settled) {
+                break;
+            }
+        }
+    }
+
+    static void forceinline solve(
+        const size_t n,
+        const size_t count,
+        real* restrict x,
+        const real* restrict a,
+        const real* restrict b,
+        const real* restrict c,
+        real* restrict r)
+    {
+        real w = real(1) / *b;
+        *r     = *c * w;
+
+        for (size_t k = 0; k < count; ++k) {
+            x[k] *= w;
+        }
+
+        for (size_t i = 1; i < n; ++i) {
+            ++b;
+            ++c;
+
+            w = real(1) / (*b - *a * *r);
+            ++r;
+            *r = *c * w;
+
+            real* restrict row        = x + i * count;
+            const real* restrict prev = row - count;
+            for (size_t k = 0; k < count; ++k) {
+                row[k] = (row[k] - *a * prev[k]) * w;
+            }
             ++a;
+        }
+
+        for (size_t i = n - 1; i > 0; --i) {
+            --r;
+
+            real* restrict row        = x + (i - 1) * count;
+            const real* restrict next = row + count;
+            for (size_t k = 0; k < count; ++k) {
+                row[k] -= *r * next[k];
+            }
+        }
+    }
+
+    // `count` independent systems of the same size, every array is interleaved as `x` of batch kernel,
+    // so `a` points to `count` subdiagonals of row 1. Inner loops run over systems and vectorize.
+    // There is a division by zero for a system exactly when `pivots[k]` (smallest |pivot| of system `k`)
+    // is 0, so failed systems are found without floating point enviroment.
+    static void forceinline solve_interleaved(
+        const size_t n,
+        const size_t count,
+        real* restrict x,
+        const real* restrict a,
+        const real* restrict b,
+        const real* restrict c,
+        real* restrict r,
+        real* restrict pivots)
+    {
+        for (size_t k = 0; k < count; ++k) {
+            real w    = real(1) / b[k];
+            pivots[k] = mod(b[k]);
+            r[k]      = c[k] * w;
+            x[k] *= w;
+        }
+
+        for (size_t i = 1; i < n; ++i) {
+            const real* restrict ai = a + (i - 1) * count;
+            const real* restrict bi = b + i * count;
+            const real* restrict ci = c + i * count;
+            const real* restrict rp = r + (i - 1) * count;
+            real* restrict ri       = r + i * count;
+            real* restrict row      = x + i * count;
+            const real* restrict xp = row - count;
+
+            for (size_t k = 0; k < count; ++k) {
+                real pivot = bi[k] - ai[k] * rp[k];
+                pivots[k]  = std::min(pivots[k], mod(pivot));
+
+                real w = real(1) / pivot;
+                ri[k]  = ci[k] * w;
+                row[k] = (row[k] - ai[k] * xp[k]) * w;
+            }
+        }
+
+        for (size_t i = n - 1; i > 0; --i) {
+            const real* restrict ri   = r + (i - 1) * count;
+            real* restrict row        = x + (i - 1) * count;
+            const real* restrict next = row + count;
+
+            for (size_t k = 0; k < count; ++k) {
+                row[k] -= ri[k] * next[k];
+            }
+        }
+    }
+
+    // `checkpoints[k]` is `r` of the last row before block `k`.
+    static void forceinline solve(
+        const size_t n,
+        real* restrict x,
+        const real* restrict a,
+        const real* restrict b,
+        const real* restrict c,
+        real* restrict r,
+        real* restrict checkpoints)
+    {
+        const size_t blocks = (n + blocked_rows - 1) / blocked_rows;
+
+        real rp = c[0] / b[0];
+        x[0]    = x[0] / b[0];
+
+        size_t i = 1;
+        for (size_t k = 0; k < blocks; ++k) {
+            const size_t last = std::min(n, (k + 1) * blocked_rows);
+
+            checkpoints[k] = rp;
+
+            for (; i < last; ++i) {
+                real w = real(1) / (b[i] - a[i - 1] * rp);
+                rp     = c[i] * w;
+                x[i]   = (x[i] - a[i - 1] * x[i - 1]) * w;
+            }
+        }
+
+        for (size_t k = blocks; k > 0; --k) {
+            const size_t first = (k - 1) * blocked_rows;
+            const size_t last  = std::min(n, first + blocked_rows);
+
+            // Same arithmetic as in forward sweep, so `r` is exactly the same.
+            i = first;
+            if (i == 0) {
+                rp   = c[0] / b[0];
+                r[0] = rp;
+                ++i;
+            } else {
+                rp = checkpoints[k - 1];
+            }
+
+            for (; i < last; ++i) {
+                rp           = c[i] * (real(1) / (b[i] - a[i - 1] * rp));
+                r[i - first] = rp;
+            }
+
+            for (i = std::min(last, n - 1); i > first; --i) {
+                x[i - 1] -= r[i - 1 - first] * x[i];
+            }
+        }
+    }
+
+    static void forceinline solve(
+        const size_t n,
+        real* restrict x,
+        const real* restrict a,
+        const real* restrict b,
+        const real* restrict c,
+        real* restrict r)
+    {
+        *r = *c / *b;
+        *x = *x / *b;
+
+        if (n < 2) {
+            return;
+        }
+
+        for (size_t i = 1; i + 1 < n; ++i) {
             ++b;
             ++c;
             ++x;
@@ -264,6 +726,35 @@ private:
             ++r;
             *r = *c * w;
             *x = (*x - *a * *(x - 1)) * w;
+            ++a;
+        }
+
+        // Last row has no `c`, `r` goes one past the sweep for backward substitution.
+        ++b;
+        ++r;
+        ++x;
+        *x = (*x - *a * *(x - 1)) / (*b - *a * *(r - 1));
+
+        for (size_t i = 1; i < n; ++i) {
+            --r;
+            --x;
+            *x -= *r * *(x + 1);
+        }
+    }
+
+    // Another right part for the sweep `r` of a previous `solve(n, x, a, b, c, r)` with the same `a` & `b`.
+    static void forceinline
+    substitute(const size_t n, real* restrict x, const real* restrict a, const real* restrict b, const real* restrict r)
+    {
+        *x = *x / *b;
+
+        for (size_t i = 1; i < n; ++i) {
+            ++b;
+            ++x;
+
+            *x = (*x - *a * *(x - 1)) / (*b - *a * *r);
+            ++a;
+            ++r;
         }
 
         for (size_t i = 1; i < n; ++i) {
@@ -279,8 +770,11 @@ private:
         *c = *c / *b;
         *x = *x / *b;
 
-        for (size_t i = 1; i < n; ++i) {
-            ++a;
+        if (n < 2) {
+            return;
+        }
+
+        for (size_t i = 1; i + 1 < n; ++i) {
             ++b;
             ++x;
 
@@ -288,8 +782,15 @@ private:
             ++c;
             *c *= w;
             *x = (*x - *a * *(x - 1)) * w;
+            ++a;
         }
 
+        // Last row has no `c`, `c` goes one past the sweep for backward substitution.
+        ++b;
+        ++c;
+        ++x;
+        *x = (*x - *a * *(x - 1)) / (*b - *a * *(c - 1));
+
         for (size_t i = 1; i < n; ++i) {
             --c;
             --x;
@@ -297,7 +798,10 @@ private:
         }
     }
 
+private:
     array<real> reusable_;
+    size_t incremental_{0};
+    uint16_t site_{0};
     bool good_;
 };
 } // namespace cmp
\ No newline at end of file
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cfenv>
+#include <complex>
+#include <cstdint>
+
+#include <initializer_list>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+#include "isclose.hpp"
+#include "restrict.hpp"
+
+/*
+ * Complex tridiagonal systems (Crank-Nicolson Schrodinger, frequency domain problems).
+ *
+ * `tridiagonal_matrix_solver<std::complex<real>>` works, but `std::complex` is stored as
+ * interleaved (re, im) pairs and its arithmetic is full of NaN/Inf recovery branches.
+ * Here real and imaginary parts are stored in separate arrays (SoA), and complex multiply
+ * and divide are fused by hand inside the sweep.
+ *
+ * Conventions are the same as in `tridiagonal.hpp`. Division is done as multiplication by
+ * conj(z) / |z|^2 without Smith scaling, so |z|^2 must not overflow. Client is responsible
+ * for normalizing input data.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class complex_array
+{
+public:
+    explicit complex_array(size_t size)
+        : re_(size)
+        , im_(size)
+    {
+    }
+
+    complex_array()
+        : re_()
+        , im_()
+    {
+    }
+
+    complex_array(std::initializer_list<std::complex<real>> l)
+        : re_(l.size())
+        , im_(l.size())
+    {
+        auto iter = l.begin();
+        for (size_t i = 0; i < l.size(); ++i) {
+            set(i, *iter);
+            ++iter;
+        }
+    }
+
+    friend bool operator==(const complex_array& a, const complex_array& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (!isclose(a[i], b[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::complex<real> operator[](size_t i) const
+    {
+        return {re_[i], im_[i]};
+    }
+
+    void set(size_t i, std::complex<real> value)
+    {
+        re_[i] = value.real();
+        im_[i] = value.imag();
+    }
+
+    size_t size() const
+    {
+        return re_.size();
+    }
+
+    array<real>& re()
+    {
+        return re_;
+    }
+
+    const array<real>& re() const
+    {
+        return re_;
+    }
+
+    array<real>& im()
+    {
+        return im_;
+    }
+
+    const array<real>& im() const
+    {
+        return im_;
+    }
+
+private:
+    array<real> re_;
+    array<real> im_;
+};
+
+/*
+ * There are 2 ways, same as for real solver:
+ *  1. Use `solve_fast(...)`
+ *     Initialy `x` is `d` and reused. Also `c` is reused.
+ *  2. Use `solve(...)`
+ *     Initialy `x` is `d` and reused. `c` is preserved. Additional space have to be
+ *     allocated using `complex_tridiagonal_matrix_solver(size_t reusable)` ctor.
+ */
+
+template <typename real = float>
+class complex_tridiagonal_matrix_solver
+{
+public:
+    complex_tridiagonal_matrix_solver(size_t reusable)
+        : reusable_(reusable)
+    {
+    }
+
+    complex_tridiagonal_matrix_solver()
+        : reusable_()
+    {
+    }
+
+    void solve_fast(
+        complex_array<real>& x,
+        const complex_array<real>& a,
+        const complex_array<real>& b,
+        complex_array<real>& c)
+    {
+        if constexpr (debug()) {
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
+        }
+
+        if (!good_determinant(a, b, c)) {
+            return;
+        }
+
+        prepare();
+
+        solve(
+            x.size(),
+            x.re().data(),
+            x.im().data(),
+            a.re().data(),
+            a.im().data(),
+            b.re().data(),
+            b.im().data(),
+            c.re().data(),
+            c.im().data(),
+            c.re().data(),
+            c.im().data());
+
+        check();
+    }
+
+    void solve(
+        complex_array<real>& x,
+        const complex_array<real>& a,
+        const complex_array<real>& b,
+        const complex_array<real>& c)
+    {
+        if constexpr (debug()) {
+            assert((x.size() <= reusable_.size()) && "Not enough reusable space for me!");
+            assert(x.size() == a.size());
+            assert(x.size() == b.size());
+            assert(x.size() == c.size());
+        }
+
+        if (!good_determinant(a, b, c)) {
+            return;
+        }
+
+        prepare();
+
+        solve(
+            x.size(),
+            x.re().data(),
+            x.im().data(),
+            a.re().data(),
+            a.im().data(),
+            b.re().data(),
+            b.im().data(),
+            c.re().data(),
+            c.im().data(),
+            reusable_.re().data(),
+            reusable_.im().data());
+
+        check();
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+private:
+    void forceinline prepare()
+    {
+        std::feclearexcept(FE_ALL_EXCEPT);
+        good_ = true;
+    }
+
+    void forceinline check()
+    {
+        if (std::fetestexcept(FE_DIVBYZERO)) {
+            [[unlikely]] good_ = false;
+        }
+    }
+
+    bool forceinline
+    good_determinant(const complex_array<real>& a, const complex_array<real>& b, const complex_array<real>& c)
+    {
+        const size_t n = a.size();
+
+        real f1_re = real(1);
+        real f1_im = real(0);
+        real f2_re = b.re()[0];
+        real f2_im = b.im()[0];
+
+        for (size_t i = 1; i < n; ++i) {
+            // ac = a[i] * c[i - 1]
+            real ac_re = a.re()[i] * c.re()[i - 1] - a.im()[i] * c.im()[i - 1];
+            real ac_im = a.re()[i] * c.im()[i - 1] + a.im()[i] * c.re()[i - 1];
+
+            // tmp = b[i] * f2 - ac * f1
+            real tmp_re = b.re()[i] * f2_re - b.im()[i] * f2_im - (ac_re * f1_re - ac_im * f1_im);
+            real tmp_im = b.re()[i] * f2_im + b.im()[i] * f2_re - (ac_re * f1_im + ac_im * f1_re);
+
+            f1_re = f2_re;
+            f1_im = f2_im;
+            f2_re = tmp_re;
+            f2_im = tmp_im;
+        }
+
+        if (isclose(std::complex<real>(f2_re, f2_im), std::complex<real>(0))) {
+            good_ = false;
+            return false;
+        }
+
+        return true;
+    }
+
+    // `r` may be `c` itself, this is the `solve_fast(...)` case. So no restrict on them.
+    static void forceinline solve(
+        const size_t n,
+        real* restrict x_re,
+        real* restrict x_im,
+        const real* restrict a_re,
+        const real* restrict a_im,
+        const real* restrict b_re,
+        const real* restrict b_im,
+        const real* c_re,
+        const real* c_im,
+        real* r_re,
+        real* r_im)
+    {
+        real den_re;
+        real den_im;
+        real w_re;
+        real w_im;
+        real t_re;
+        real t_im;
+        real inv;
+
+        // w = 1 / b
+        inv  = real(1) / (b_re[0] * b_re[0] + b_im[0] * b_im[0]);
+        w_re = b_re[0] * inv;
+        w_im = -b_im[0] * inv;
+
+        t_re    = c_re[0];
+        t_im    = c_im[0];
+        r_re[0] = t_re * w_re - t_im * w_im;
+        r_im[0] = t_re * w_im + t_im * w_re;
+
+        t_re    = x_re[0];
+        t_im    = x_im[0];
+        x_re[0] = t_re * w_re - t_im * w_im;
+        x_im[0] = t_re * w_im + t_im * w_re;
+
+        for (size_t i = 1; i < n; ++i) {
+            // den = b - a * r
+            den_re = b_re[i] - (a_re[i] * r_re[i - 1] - a_im[i] * r_im[i - 1]);
+            den_im = b_im[i] - (a_re[i] * r_im[i - 1] + a_im[i] * r_re[i - 1]);
+
+            // w = conj(den) / |den|^2
+            inv  = real(1) / (den_re * den_re + den_im * den_im);
+            w_re = den_re * inv;
+            w_im = -den_im * inv;
+
+            // r = c * w
+            t_re    = c_re[i];
+            t_im    = c_im[i];
+            r_re[i] = t_re * w_re - t_im * w_im;
+            r_im[i] = t_re * w_im + t_im * w_re;
+
+            // x = (x - a * x_prev) * w
+            t_re    = x_re[i] - (a_re[i] * x_re[i - 1] - a_im[i] * x_im[i - 1]);
+            t_im    = x_im[i] - (a_re[i] * x_im[i - 1] + a_im[i] * x_re[i - 1]);
+            x_re[i] = t_re * w_re - t_im * w_im;
+            x_im[i] = t_re * w_im + t_im * w_re;
+        }
+
+        for (size_t i = n - 1; i > 0; --i) {
+            // x -= r * x_next
+            x_re[i - 1] -= r_re[i - 1] * x_re[i] - r_im[i - 1] * x_im[i];
+            x_im[i - 1] -= r_re[i - 1] * x_im[i] + r_im[i - 1] * x_re[i];
+        }
+    }
+
+    complex_array<real> reusable_;
+    bool good_;
+};
+} // namespace cmp
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cfenv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "array.hpp"
+#include "debug.hpp"
+#include "forceinline.hpp"
+#include "mod.hpp"
+#include "restrict.hpp"
+
+/*
+ * Tridiagonal solver with partial pivoting, for systems that are not diagonally dominant.
+ *
+ * Factorization is P A = L U as in LAPACK `?gttrf`: at row `i` rows `i` and `i + 1` are swapped when
+ * |a[i + 1]| > |b'[i]|, and then U gets a second superdiagonal fill-in `du2`. L is unit lower bidiagonal.
+ * Well-behaved rows take the same branch every time, so the only unpredictable branch is a swap.
+ *
+ * Conventions are the same as in `tridiagonal.hpp`, `a`, `b` & `c` are preserved.
+ * Factors are kept in LAPACK layout, so more right parts can be solved with `solve(x)` later.
+ * All space is allocated in `pivoting_tridiagonal_matrix_solver(size_t n)` ctor.
+ *
+ * Singular matrix shows up as division by 0 (or 0 / 0) on some exactly zero pivot, floating point
+ * enviroment is checked as in `tridiagonal_matrix_solver`. This is a client responsibility to check
+ * for `good()` after `factor(...)` and `solve(...)`.
+ */
+
+namespace cmp
+{
+
+template <typename real = float>
+class pivoting_tridiagonal_matrix_solver
+{
+public:
+    explicit pivoting_tridiagonal_matrix_solver(size_t n)
+        : dl_(n)
+        , d_(n)
+        , du_(n)
+        , du2_(n)
+        , pivots_(n)
+    {
+    }
+
+    void factor(const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        const size_t n = b.size();
+
+        if constexpr (debug()) {
+            assert((n <= d_.size()) && "Not enough reusable space for me!");
+            assert(n == a.size());
+            assert(n == c.size());
+        }
+
+        prepare();
+
+        n_ = n;
+        if (n == 0) {
+            // Empty system is trivially solved, there is nothing to factor.
+            return;
+        }
+
+        memcpy(dl_.data(), a.data() + 1, sizeof(real) * (n - 1));
+        memcpy(d_.data(), b.data(), sizeof(real) * n);
+        memcpy(du_.data(), c.data(), sizeof(real) * (n - 1));
+
+        factor(n, dl_.data(), d_.data(), du_.data(), du2_.data(), pivots_.data());
+
+        check();
+    }
+
+    // Solve with factors of the last `factor(...)`, initialy `x` is `d` and reused.
+    void solve(array<real>& x)
+    {
+        if constexpr (debug()) {
+            assert(x.size() == n_);
+        }
+
+        prepare();
+
+        if (n_ == 0) {
+            return;
+        }
+
+        solve(n_, x.data(), dl_.data(), d_.data(), du_.data(), du2_.data(), pivots_.data());
+
+        check();
+    }
+
+    void solve(array<real>& x, const array<real>& a, const array<real>& b, const array<real>& c)
+    {
+        factor(a, b, c);
+        if (good_) {
+            solve(x);
+        }
+    }
+
+    bool good() const
+    {
+        return good_;
+    }
+
+    // Factors in LAPACK `?gttrf` layout, valid after `factor(...)`.
+    const array<real>& dl() const
+    {
+        return dl_;
+    }
+
+    const array<real>& d() const
+    {
+        return d_;
+    }
+
+    const array<real>& du() const
+    {
+        return du_;
+    }
+
+    const array<real>& du2() const
+    {
+        return du2_;
+    }
+
+    const array<int>& pivots() const
+    {
+        return pivots_;
+    }
+
+    // Raw kernels in LAPACK layout: `dl` & `du` are n - 1 length, `du2` is n - 2 length, `ipiv` is 1 based.
+    // There are no checks here at all, floating point enviroment have to be handled by caller.
+
+    static void forceinline factor(
+        const size_t n,
+        real* restrict dl,
+        real* restrict d,
+        real* restrict du,
+        real* restrict du2,
+        int* restrict ipiv)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            ipiv[i] = int(i + 1);
+        }
+
+        for (size_t i = 0; i + 2 < n; ++i) {
+            du2[i] = real(0);
+
+            if (mod(d[i]) >= mod(dl[i])) {
+                // No swap. Zero pivot here means zero column too, so it is 0 / 0.
+                real l = dl[i] / d[i];
+                dl[i]  = l;
+                d[i + 1] -= l * du[i];
+            } else [[unlikely]] {
+                real l    = d[i] / dl[i];
+                real u    = du[i];
+                d[i]      = dl[i];
+                dl[i]     = l;
+                du[i]     = d[i + 1];
+                d[i + 1]  = u - l * d[i + 1];
+                du2[i]    = du[i + 1];
+                du[i + 1] = -l * du[i + 1];
+                ipiv[i]   = int(i + 2);
+            }
+        }
+
+        // Last row has no fill-in.
+        if (n > 1) {
+            const size_t i = n - 2;
+
+            if (mod(d[i]) >= mod(dl[i])) {
+                real l = dl[i] / d[i];
+                dl[i]  = l;
+                d[i + 1] -= l * du[i];
+            } else {
+                real l   = d[i] / dl[i];
+                real u   = du[i];
+                d[i]     = dl[i];
+                dl[i]    = l;
+                du[i]    = d[i + 1];
+                d[i + 1] = u - l * d[i + 1];
+                ipiv[i]  = int(i + 2);
+            }
+        }
+    }
+
+    static void forceinline solve(
+        const size_t n,
+        real* restrict x,
+        const real* restrict dl,
+        const real* restrict d,
+        const real* restrict du,
+        const real* restrict du2,
+        const int* restrict ipiv)
+    {
+        // L, swap is folded into indexing: `p` is either `i` or `i + 1`.
+        for (size_t i = 0; i + 1 < n; ++i) {
+            size_t p = size_t(ipiv[i] - 1);
+            real t   = x[2 * i + 1 - p] - dl[i] * x[p];
+            x[i]     = x[p];
+            x[i + 1] = t;
+        }
+
+        // U
+        x[n - 1] /= d[n - 1];
+        if (n > 1) {
+            x[n - 2] = (x[n - 2] - du[n - 2] * x[n - 1]) / d[n - 2];
+        }
+        for (size_t i = n; i-- > 2;) {
+            x[i - 2] = (x[i - 2] - du[i - 2] * x[i - 1] - du2[i - 2] * x[i]) / d[i - 2];
+        }
+    }
+
+    // Elimination & substitution in one go, as LAPACK `?gtsv`: factors are not kept, so there is no
+    // `du2` & `ipiv`. Fill-in of U goes into `dl`, so `dl`, `d` & `du` end up as U of reference `?gtsv`.
+    // `nrhs` right parts are columns of `x` with leading dimension `ldx`. Zero pivot is checked exactly,
+    // as LAPACK does, so there is no division by 0. Returns 1 based index of zero pivot, or 0.
+    static size_t forceinline solve(
+        const size_t n,
+        const size_t nrhs,
+        real* restrict x,
+        const size_t ldx,
+        real* restrict dl,
+        real* restrict d,
+        real* restrict du)
+    {
+        for (size_t i = 0; i + 1 < n; ++i) {
+            const bool fill = i + 2 < n;
+
+            if (mod(d[i]) >= mod(dl[i])) {
+                // Zero column.
+                if (std::fpclassify(d[i]) == FP_ZERO) {
+                    [[unlikely]] return i + 1;
+                }
+
+                real l = dl[i] / d[i];
+                d[i + 1] -= l * du[i];
+                for (size_t j = 0; j < nrhs; ++j) {
+                    x[j * ldx + i + 1] -= l * x[j * ldx + i];
+                }
+                if (fill) {
+                    dl[i] = real(0);
+                }
+            } else [[unlikely]] {
+                real l   = d[i] / dl[i];
+                real t   = d[i + 1];
+                d[i]     = dl[i];
+                d[i + 1] = du[i] - l * t;
+                if (fill) {
+                    dl[i]     = du[i + 1];
+                    du[i + 1] = -l * dl[i];
+                }
+                du[i] = t;
+                for (size_t j = 0; j < nrhs; ++j) {
+                    real* restrict column = x + j * ldx;
+
+                    real top      = column[i];
+                    column[i]     = column[i + 1];
+                    column[i + 1] = top - l * column[i + 1];
+                }
+            }
+        }
+
+        if (std::fpclassify(d[n - 1]) == FP_ZERO) {
+            return n;
+        }
+
+        // U, `dl` is its second superdiagonal.
+        for (size_t j = 0; j < nrhs; ++j) {
+            real* restrict column = x + j * ldx;
+
+            column[n - 1] /= d[n - 1];
+            if (n > 1) {
+                column[n - 2] = (column[n - 2] - du[n - 2] * column[n - 1]) / d[n - 2];
+            }
+            for (size_t i = n; i-- > 2;) {
+                column[i - 2] = (column[i - 2] - du[i - 2] * column[i - 1] - dl[i - 2] * column[i]) / d[i - 2];
+            }
+        }
+
+        return 0;
+    }
+
+private:
+    void forceinline prepare()
+    {
+        std::feclearexcept(FE_ALL_EXCEPT);
+        good_ = true;
+    }
+
+    void forceinline check()
+    {
+        if (std::fetestexcept(FE_DIVBYZERO | FE_INVALID)) {
+            [[unlikely]] good_ = false;
+        }
+    }
+
+    array<real> dl_;
+    array<real> d_;
+    array<real> du_;
+    array<real> du2_;
+    array<int> pivots_;
+    size_t n_{0};
+    bool good_{false};
+};
+} // namespace cmp
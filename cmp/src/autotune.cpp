@@ -0,0 +1,165 @@
+#include "autotune.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace cmp
+{
+
+tuning_table::tuning_table()
+{
+    for (size_t p = 0; p < precisions; ++p) {
+        for (size_t b = 0; b < buckets; ++b) {
+            table_[p][b] = solve_strategy::unknown;
+        }
+    }
+}
+
+tuning_table& tuning_table::instance()
+{
+    static tuning_table table;
+    static bool loaded = table.load();
+
+    (void)loaded;
+    return table;
+}
+
+const char* tuning_table::path()
+{
+    const char* env = std::getenv("THOMAS_TUNE_CACHE");
+    return env != nullptr ? env : "tune.dat";
+}
+
+const char* tuning_table::cpu()
+{
+    static const std::string model = [] {
+        std::string result;
+
+#if defined(__x86_64__) || defined(__i386__)
+        // Brand string is in 3 leaves of extended CPUID.
+        unsigned int words[12] = {};
+        unsigned int top       = __get_cpuid_max(0x80000000, nullptr);
+        if (top >= 0x80000004) {
+            for (unsigned int leaf = 0; leaf < 3; ++leaf) {
+                unsigned int* w = words + 4 * leaf;
+                __get_cpuid(0x80000002 + leaf, &w[0], &w[1], &w[2], &w[3]);
+            }
+            result.assign(reinterpret_cast<const char*>(words), strnlen(reinterpret_cast<const char*>(words), sizeof(words)));
+        }
+#endif
+
+        // One token, so it is a column of cache file.
+        std::string token;
+        for (char ch : result) {
+            if (std::isspace(static_cast<unsigned char>(ch))) {
+                if (!token.empty() && token.back() != '_') {
+                    token += '_';
+                }
+            } else {
+                token += ch;
+            }
+        }
+        while (!token.empty() && token.back() == '_') {
+            token.pop_back();
+        }
+
+        return token.empty() ? std::string("unknown") : token;
+    }();
+
+    return model.c_str();
+}
+
+const char* tuning_table::name(solve_strategy strategy)
+{
+    switch (strategy) {
+        case solve_strategy::solve_fast:
+            return "solve_fast";
+        case solve_strategy::solve:
+            return "solve";
+        case solve_strategy::solve_slow:
+            return "solve_slow";
+        case solve_strategy::solve_blocked:
+            return "solve_blocked";
+        case solve_strategy::unknown:
+        default:
+            return "unknown";
+    }
+}
+
+// Format is one line per tuned bucket: CPU model, precision in bytes, bucket, strategy name.
+bool tuning_table::load()
+{
+    std::lock_guard<std::mutex> lock(file_);
+
+    std::ifstream input(path());
+    if (!input) {
+        return false;
+    }
+
+    std::string model;
+    size_t precision;
+    size_t bucket;
+    std::string strategy;
+
+    while (input >> model >> precision >> bucket >> strategy) {
+        if (bucket >= buckets || model != cpu()) {
+            continue;
+        }
+
+        for (solve_strategy s :
+             {solve_strategy::solve_fast, solve_strategy::solve, solve_strategy::solve_slow, solve_strategy::solve_blocked}) {
+            if (strategy == name(s)) {
+                set(precision, bucket, s);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool tuning_table::save() const
+{
+    std::lock_guard<std::mutex> lock(file_);
+
+    // Other machines' entries go back as they were.
+    std::ostringstream others;
+    {
+        std::ifstream input(path());
+        std::string line;
+        while (input && std::getline(input, line)) {
+            std::istringstream fields(line);
+            std::string model;
+            if (fields >> model && model != cpu()) {
+                others << line << "\n";
+            }
+        }
+    }
+
+    std::ofstream output(path());
+    if (!output) {
+        return false;
+    }
+
+    output << others.str();
+
+    const size_t sizes[precisions] = {sizeof(float), sizeof(double), sizeof(long double)};
+
+    for (size_t p = 0; p < precisions; ++p) {
+        for (size_t b = 0; b < buckets; ++b) {
+            solve_strategy strategy = table_[p][b].load(std::memory_order_relaxed);
+            if (strategy != solve_strategy::unknown) {
+                output << cpu() << " " << sizes[p] << " " << b << " " << name(strategy) << "\n";
+            }
+        }
+    }
+
+    return bool(output);
+}
+} // namespace cmp
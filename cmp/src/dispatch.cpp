@@ -0,0 +1,75 @@
+#include "dispatch.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <initializer_list>
+
+namespace cmp
+{
+
+namespace
+{
+
+isa startup()
+{
+    isa level = isa_dispatch::detected();
+
+    const char* env = std::getenv("THOMAS_ISA");
+    isa wanted;
+    if (env != nullptr && isa_dispatch::parse(env, wanted) && wanted < level) {
+        level = wanted;
+    }
+
+    return level;
+}
+} // namespace
+
+isa isa_dispatch::selected_ = startup();
+
+isa isa_dispatch::detected()
+{
+#ifdef CMP_MULTIVERSION
+    // Static initialization may run before CPU model is filled by libgcc.
+    __builtin_cpu_init();
+
+    static const isa level = __builtin_cpu_supports("avx512f") ? isa::avx512
+                             : __builtin_cpu_supports("avx2")  ? isa::avx2
+                                                               : isa::baseline;
+    return level;
+#else
+    return isa::baseline;
+#endif
+}
+
+isa isa_dispatch::select(isa level)
+{
+    selected_ = level < detected() ? level : detected();
+    return selected_;
+}
+
+const char* isa_dispatch::name(isa level)
+{
+    switch (level) {
+        case isa::avx2:
+            return "avx2";
+        case isa::avx512:
+            return "avx512";
+        case isa::baseline:
+        default:
+            return "baseline";
+    }
+}
+
+bool isa_dispatch::parse(const char* name, isa& level)
+{
+    for (isa candidate : {isa::baseline, isa::avx2, isa::avx512}) {
+        if (strcmp(name, isa_dispatch::name(candidate)) == 0) {
+            level = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
+} // namespace cmp
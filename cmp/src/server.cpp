@@ -0,0 +1,744 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "debug.hpp"
+#include "tridiagonal.hpp"
+
+namespace cmp
+{
+
+namespace
+{
+
+#ifdef MSG_NOSIGNAL
+constexpr int send_flags = MSG_NOSIGNAL;
+#else
+constexpr int send_flags = 0;
+#endif
+
+constexpr size_t header_size = sizeof(frame_header);
+
+// Longest wait in `poll`, so `stop()` is noticed.
+constexpr uint64_t idle_us = 50000;
+
+uint64_t now()
+{
+    auto since = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(since).count());
+}
+
+bool nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool address(const char* path, sockaddr_un& result)
+{
+    if (strlen(path) >= sizeof(result.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    memset(&result, 0, sizeof(result));
+    result.sun_family = AF_UNIX;
+    strcpy(result.sun_path, path);
+    return true;
+}
+
+void wait(pollfd* fds, size_t count, uint64_t timeout_us)
+{
+#ifdef __linux__
+    timespec timeout{time_t(timeout_us / 1000000), long(timeout_us % 1000000) * 1000};
+    ppoll(fds, nfds_t(count), &timeout, nullptr);
+#else
+    poll(fds, nfds_t(count), int((timeout_us + 999) / 1000));
+#endif
+}
+
+// Requests of one size & precision waiting for a batch solve, each is copied as is: a, b, c, d.
+template <typename real>
+struct group {
+    size_t n{0};
+    size_t count{0};
+    uint64_t deadline{0};
+
+    array<real> systems;
+    array<uint64_t> ids;
+    array<uint32_t> owners;
+    array<uint64_t> serials;
+
+    group(size_t rows, size_t batch)
+        : systems(4 * rows * batch)
+        , ids(batch)
+        , owners(batch)
+        , serials(batch)
+    {
+    }
+};
+
+// Batch groups & interleaved staging of one precision.
+template <typename real>
+struct engine {
+    size_t max_batch;
+    size_t groups_count;
+    group<real>* groups;
+
+    array<real> a;
+    array<real> b;
+    array<real> c;
+    array<real> x;
+    array<real> r;
+    array<real> pivots;
+
+    explicit engine(const server_config& config)
+        : max_batch(config.max_batch)
+        , groups_count(config.max_groups)
+        , groups(static_cast<group<real>*>(operator new(sizeof(group<real>) * config.max_groups)))
+        , a(std::max(config.max_n, config.batch_rows * config.max_batch))
+        , b(a.size())
+        , c(a.size())
+        , x(a.size())
+        , r(a.size())
+        , pivots(config.max_batch)
+    {
+        for (size_t g = 0; g < groups_count; ++g) {
+            new (groups + g) group<real>(config.batch_rows, config.max_batch);
+        }
+    }
+
+    ~engine()
+    {
+        for (size_t g = 0; g < groups_count; ++g) {
+            groups[g].~group<real>();
+        }
+        operator delete(groups);
+    }
+
+    engine(const engine&) = delete;
+
+    engine& operator=(const engine&) = delete;
+
+    // Open group of size `n`, or empty one, or nullptr when all are busy.
+    group<real>* find(size_t n)
+    {
+        group<real>* empty = nullptr;
+        for (size_t g = 0; g < groups_count; ++g) {
+            if (groups[g].count > 0 && groups[g].n == n) {
+                return groups + g;
+            }
+            if (groups[g].count == 0 && empty == nullptr) {
+                empty = groups + g;
+            }
+        }
+        return empty;
+    }
+
+    group<real>* oldest()
+    {
+        group<real>* result = groups;
+        for (size_t g = 1; g < groups_count; ++g) {
+            if (groups[g].deadline < result->deadline) {
+                result = groups + g;
+            }
+        }
+        return result;
+    }
+
+    // Solves `count` systems of size `n`, `source(k)` points to a, b, c, d of system `k`.
+    template <typename source_t>
+    void solve(size_t n, size_t count, source_t source)
+    {
+        for (size_t k = 0; k < count; ++k) {
+            const real* system = source(k);
+            for (size_t i = 0; i < n; ++i) {
+                a[i * count + k] = system[i];
+                b[i * count + k] = system[n + i];
+                c[i * count + k] = system[2 * n + i];
+                x[i * count + k] = system[3 * n + i];
+            }
+
+            a[k]                   = real(0);
+            c[(n - 1) * count + k] = real(0);
+        }
+
+        tridiagonal_matrix_solver<real>::solve_interleaved(
+            n, count, x.data(), a.data() + count, b.data(), c.data(), r.data(), pivots.data());
+    }
+
+    bool good(size_t k) const
+    {
+        return pivots[k] > real(0);
+    }
+
+    real result(size_t count, size_t k, size_t i) const
+    {
+        return x[i * count + k];
+    }
+};
+
+// Socket & its buffers, allocated once for all connections served in this slot.
+struct connection {
+    int fd{-1};
+    uint64_t serial{0};
+
+    array<uint8_t> in;
+    size_t in_size{0};
+
+    array<uint8_t> out;
+    size_t out_begin{0};
+    size_t out_end{0};
+
+    // Bytes of responses still in batch groups, space for them is kept in `out`.
+    size_t reserved{0};
+
+    // Peer is done writing, or sent garbage: close when everything is sent.
+    bool closing{false};
+
+    explicit connection(size_t max_n)
+        : in(header_size + 4 * max_n * sizeof(double))
+        , out(2 * (header_size + max_n * sizeof(double)))
+    {
+    }
+
+    size_t pending() const
+    {
+        return out_end - out_begin;
+    }
+
+    bool fits(size_t bytes) const
+    {
+        return out.size() - pending() >= reserved + bytes;
+    }
+
+    // Space at the end of `out`, caller checked `fits(bytes)`.
+    uint8_t* append(size_t bytes)
+    {
+        if (out.size() - out_end < bytes) {
+            memmove(out.data(), out.data() + out_begin, pending());
+            out_end -= out_begin;
+            out_begin = 0;
+        }
+
+        uint8_t* result = out.data() + out_end;
+        out_end += bytes;
+        return result;
+    }
+};
+} // namespace
+
+struct solve_server::state {
+    const server_config& config;
+    server_stats& stats;
+
+    int listener{-1};
+    uint64_t serial{0};
+
+    connection* connections;
+    array<pollfd> polls;
+    engine<float> floats;
+    engine<double> doubles;
+
+    state(const server_config& settings, server_stats& counters)
+        : config(settings)
+        , stats(counters)
+        , connections(static_cast<connection*>(operator new(sizeof(connection) * settings.max_connections)))
+        , polls(settings.max_connections + 1)
+        , floats(settings)
+        , doubles(settings)
+    {
+        for (size_t i = 0; i < settings.max_connections; ++i) {
+            new (connections + i) connection(settings.max_n);
+        }
+    }
+
+    ~state()
+    {
+        for (size_t i = 0; i < config.max_connections; ++i) {
+            if (connections[i].fd >= 0) {
+                ::close(connections[i].fd);
+            }
+            connections[i].~connection();
+        }
+        operator delete(connections);
+
+        if (listener >= 0) {
+            ::close(listener);
+            unlink(config.path);
+        }
+    }
+
+    state(const state&) = delete;
+
+    state& operator=(const state&) = delete;
+
+    void step(bool stopping)
+    {
+        const size_t capacity = config.max_connections;
+
+        // Stalled connections are polled for output only, until responses drain.
+        bool room       = false;
+        polls[capacity] = {listener, 0, 0};
+        for (size_t i = 0; i < capacity; ++i) {
+            connection& c = connections[i];
+            polls[i]      = {c.fd, 0, 0};
+            if (c.fd < 0) {
+                room = true;
+                continue;
+            }
+            if (!c.closing && c.fits(header_size + config.max_n * sizeof(double))) {
+                polls[i].events |= POLLIN;
+            }
+            if (c.pending() > 0) {
+                polls[i].events |= POLLOUT;
+            } else if (c.closing) {
+                // Only waits for batched responses, hung up peer would report POLLHUP on every poll.
+                polls[i].fd = -1;
+            }
+        }
+        if (room && !stopping) {
+            polls[capacity].events = POLLIN;
+        }
+
+        uint64_t timeout = idle_us;
+        uint64_t time    = now();
+        uint64_t next    = std::min(deadline(floats), deadline(doubles));
+        if (next != UINT64_MAX) {
+            timeout = next > time ? std::min(timeout, next - time) : 0;
+        }
+
+        wait(polls.data(), capacity + 1, timeout);
+
+        if (polls[capacity].revents & POLLIN) {
+            accept();
+        }
+
+        for (size_t i = 0; i < capacity; ++i) {
+            connection& c = connections[i];
+            if (c.fd < 0 || polls[i].fd != c.fd) {
+                continue;
+            }
+
+            const short events = polls[i].revents;
+            if (events & (POLLIN | POLLHUP | POLLERR)) {
+                receive(uint32_t(i));
+            }
+            if (c.fd >= 0 && (events & POLLOUT)) {
+                send(c);
+            }
+        }
+
+        flush(floats, stopping);
+        flush(doubles, stopping);
+
+        // Requests stalled on output space are retried once responses are sent.
+        for (size_t i = 0; i < capacity; ++i) {
+            connection& c = connections[i];
+            if (c.fd >= 0 && c.in_size >= header_size) {
+                parse(uint32_t(i));
+            }
+            if (c.fd >= 0) {
+                send(c);
+            }
+        }
+    }
+
+    void accept()
+    {
+        int fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < config.max_connections; ++i) {
+            connection& c = connections[i];
+            if (c.fd < 0) {
+                if (!nonblocking(fd)) {
+                    break;
+                }
+
+                c.fd        = fd;
+                c.serial    = ++serial;
+                c.in_size   = 0;
+                c.out_begin = 0;
+                c.out_end   = 0;
+                c.reserved  = 0;
+                c.closing   = false;
+                return;
+            }
+        }
+
+        ::close(fd);
+    }
+
+    void receive(uint32_t index)
+    {
+        connection& c = connections[index];
+
+        while (!c.closing) {
+            ssize_t got = recv(c.fd, c.in.data() + c.in_size, c.in.size() - c.in_size, 0);
+            if (got == 0) {
+                c.closing = true;
+            } else if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close(c);
+                    return;
+                }
+                break;
+            } else {
+                c.in_size += size_t(got);
+            }
+
+            if (!parse(index) || c.in_size == c.in.size()) {
+                break;
+            }
+        }
+    }
+
+    // Handles complete requests in `in`, false when stalled on output space.
+    bool parse(uint32_t index)
+    {
+        connection& c   = connections[index];
+        size_t consumed = 0;
+        bool stalled    = false;
+
+        while (c.fd >= 0 && c.in_size - consumed >= header_size) {
+            frame_header header;
+            memcpy(&header, c.in.data() + consumed, header_size);
+
+            const bool valid = header.magic == frame_header::signature &&
+                               (header.precision == sizeof(float) || header.precision == sizeof(double)) &&
+                               header.n > 0 && header.n <= config.max_n;
+
+            if (!valid) {
+                // Stream can't be resynchronized.
+                if (c.fits(header_size)) {
+                    respond(c, header.id, frame_status::bad_request, 0, 0);
+                }
+                c.in_size = 0;
+                c.closing = true;
+                return false;
+            }
+
+            const size_t bytes = header_size + 4 * size_t(header.n) * header.precision;
+            if (c.in_size - consumed < bytes) {
+                break;
+            }
+            if (!c.fits(header_size + size_t(header.n) * header.precision)) {
+                stalled = true;
+                break;
+            }
+
+            const uint8_t* payload = c.in.data() + consumed + header_size;
+            if (header.precision == sizeof(float)) {
+                request(floats, index, header, payload);
+            } else {
+                request(doubles, index, header, payload);
+            }
+
+            stats.requests.fetch_add(1, std::memory_order_relaxed);
+            consumed += bytes;
+        }
+
+        memmove(c.in.data(), c.in.data() + consumed, c.in_size - consumed);
+        c.in_size -= consumed;
+        return !stalled;
+    }
+
+    template <typename real>
+    void request(engine<real>& e, uint32_t index, const frame_header& header, const uint8_t* payload)
+    {
+        connection& c = connections[index];
+        const size_t n = header.n;
+
+        if (n > config.batch_rows) {
+            // Frames are multiples of 4 bytes after 8 aligned header, so payload is aligned for `real`.
+            const real* system = reinterpret_cast<const real*>(payload);
+
+            e.solve(n, 1, [&](size_t) { return system; });
+            stats.batches.fetch_add(1, std::memory_order_relaxed);
+            deliver(e, c, header.id, 1, 0, n);
+            return;
+        }
+
+        group<real>* g = e.find(n);
+        if (g == nullptr) {
+            g = e.oldest();
+            flush(e, *g);
+            g = e.find(n);
+        }
+
+        if (g->count == 0) {
+            g->n        = n;
+            g->deadline = now() + config.budget_us;
+        }
+
+        const size_t k = g->count++;
+        memcpy(g->systems.data() + 4 * n * k, payload, 4 * n * sizeof(real));
+        g->ids[k]     = header.id;
+        g->owners[k]  = index;
+        g->serials[k] = c.serial;
+        c.reserved += header_size + n * sizeof(real);
+
+        if (g->count == e.max_batch) {
+            flush(e, *g);
+        }
+    }
+
+    template <typename real>
+    void flush(engine<real>& e, bool all)
+    {
+        const uint64_t time = now();
+        for (size_t g = 0; g < e.groups_count; ++g) {
+            if (e.groups[g].count > 0 && (all || e.groups[g].deadline <= time)) {
+                flush(e, e.groups[g]);
+            }
+        }
+    }
+
+    template <typename real>
+    void flush(engine<real>& e, group<real>& g)
+    {
+        const size_t n     = g.n;
+        const size_t count = g.count;
+
+        const real* systems = g.systems.data();
+        e.solve(n, count, [&](size_t k) { return systems + 4 * n * k; });
+        stats.batches.fetch_add(1, std::memory_order_relaxed);
+
+        for (size_t k = 0; k < count; ++k) {
+            connection& c = connections[g.owners[k]];
+            if (c.fd < 0 || c.serial != g.serials[k]) {
+                continue;
+            }
+
+            c.reserved -= header_size + n * sizeof(real);
+            deliver(e, c, g.ids[k], count, k, n);
+        }
+
+        g.count = 0;
+    }
+
+    template <typename real>
+    void deliver(const engine<real>& e, connection& c, uint64_t id, size_t count, size_t k, size_t n)
+    {
+        if (!e.good(k)) {
+            stats.failed.fetch_add(1, std::memory_order_relaxed);
+            respond(c, id, frame_status::bad_system, 0, 0);
+            return;
+        }
+
+        uint8_t* payload = respond(c, id, frame_status::ok, n, sizeof(real));
+        for (size_t i = 0; i < n; ++i) {
+            real value = e.result(count, k, i);
+            memcpy(payload + i * sizeof(real), &value, sizeof(real));
+        }
+    }
+
+    // Header of response with `n` reals of `precision` bytes to follow, returns where they go.
+    uint8_t* respond(connection& c, uint64_t id, frame_status status, size_t n, size_t precision)
+    {
+        const size_t bytes = header_size + n * precision;
+
+        if constexpr (debug()) {
+            assert(c.out.size() - c.pending() >= bytes);
+        }
+
+        frame_header header{frame_header::signature, uint16_t(precision), uint16_t(status), uint32_t(n), 0, id};
+
+        uint8_t* result = c.append(bytes);
+        memcpy(result, &header, header_size);
+        return result + header_size;
+    }
+
+    // Sends what socket takes, closes connection when it is done.
+    void send(connection& c)
+    {
+        while (c.pending() > 0) {
+            ssize_t sent = ::send(c.fd, c.out.data() + c.out_begin, c.pending(), send_flags);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close(c);
+                }
+                return;
+            }
+            c.out_begin += size_t(sent);
+        }
+
+        c.out_begin = 0;
+        c.out_end   = 0;
+
+        if (c.closing && c.reserved == 0) {
+            close(c);
+        }
+    }
+
+    void close(connection& c)
+    {
+        ::close(c.fd);
+        c.fd        = -1;
+        c.reserved  = 0;
+        c.in_size   = 0;
+        c.out_begin = 0;
+        c.out_end   = 0;
+    }
+
+    template <typename real>
+    static uint64_t deadline(const engine<real>& e)
+    {
+        uint64_t result = UINT64_MAX;
+        for (size_t g = 0; g < e.groups_count; ++g) {
+            if (e.groups[g].count > 0) {
+                result = std::min(result, e.groups[g].deadline);
+            }
+        }
+        return result;
+    }
+};
+
+solve_server::solve_server(const server_config& config)
+    : config_(config)
+{
+    if constexpr (debug()) {
+        assert(config.max_n > 0 && config.max_connections > 0);
+        assert(config.batch_rows <= config.max_n);
+        assert(config.max_batch > 0 && config.max_groups > 0);
+    }
+}
+
+solve_server::~solve_server()
+{
+    delete state_;
+}
+
+bool solve_server::listen()
+{
+    sockaddr_un where;
+    if (!address(config_.path, where)) {
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // Stale socket of a previous run.
+    unlink(config_.path);
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&where), sizeof(where)) != 0 ||
+        ::listen(fd, int(config_.max_connections)) != 0 || !nonblocking(fd)) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+
+    delete state_;
+    state_           = new state(config_, stats_);
+    state_->listener = fd;
+    return true;
+}
+
+void solve_server::run()
+{
+    if constexpr (debug()) {
+        assert(state_ != nullptr && "Call listen() first!");
+    }
+
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        state_->step(false);
+    }
+
+    // Pending batches are solved and sent as far as socket buffers allow.
+    state_->step(true);
+
+    delete state_;
+    state_ = nullptr;
+}
+
+void solve_server::stop()
+{
+    stopping_.store(true, std::memory_order_relaxed);
+}
+
+const server_stats& solve_server::stats() const
+{
+    return stats_;
+}
+
+solve_client::solve_client(const char* path)
+{
+    sockaddr_un where;
+    if (!address(path, where)) {
+        return;
+    }
+
+    fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ >= 0 && connect(fd_, reinterpret_cast<const sockaddr*>(&where), sizeof(where)) != 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+solve_client::~solve_client()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool solve_client::write(const void* data, size_t bytes)
+{
+    const uint8_t* from = static_cast<const uint8_t*>(data);
+
+    while (bytes > 0) {
+        ssize_t sent = ::send(fd_, from, bytes, send_flags);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        from += sent;
+        bytes -= size_t(sent);
+    }
+
+    return true;
+}
+
+bool solve_client::read(void* data, size_t bytes)
+{
+    uint8_t* to = static_cast<uint8_t*>(data);
+
+    while (bytes > 0) {
+        ssize_t got = recv(fd_, to, bytes, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        to += got;
+        bytes -= size_t(got);
+    }
+
+    return true;
+}
+} // namespace cmp
@@ -0,0 +1,31 @@
+#include "shared_allocator.hpp"
+
+#include <sys/mman.h>
+
+namespace cmp
+{
+
+// Mapping size is stored right before user pointer. Header is 64 bytes to keep user data cache line aligned.
+static constexpr size_t header = 64;
+
+void* shared_allocator::allocate(size_t size)
+{
+    void* ptr = mmap(nullptr, size + header, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *reinterpret_cast<size_t*>(ptr) = size + header;
+    return reinterpret_cast<unsigned char*>(ptr) + header;
+}
+
+void shared_allocator::deallocate(void* ptr)
+{
+    if (ptr == nullptr) {
+        return;
+    }
+
+    void* base = reinterpret_cast<unsigned char*>(ptr) - header;
+    munmap(base, *reinterpret_cast<size_t*>(base));
+}
+} // namespace cmp
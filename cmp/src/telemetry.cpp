@@ -0,0 +1,264 @@
+#include "telemetry.hpp"
+
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+namespace cmp
+{
+
+namespace
+{
+
+struct solve_record {
+    uint64_t ticks;
+    uint64_t n;
+    uint16_t site;
+    solve_mode mode;
+    bool good;
+};
+
+// Single producer (owning thread), single consumer (snapshot under lock).
+struct ring {
+    static constexpr size_t capacity = 4096;
+
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    ring* next{nullptr};
+
+    // Guarded by registry `lock`. Ring of exited thread is adopted by the next new thread.
+    bool owned{true};
+
+    solve_record records[capacity];
+};
+
+static_assert((ring::capacity & (ring::capacity - 1)) == 0);
+
+struct registry {
+    std::mutex lock;
+
+    // Rings are recycled rather than freed, thread may exit with records not drained yet.
+    // So there are as many rings as there were threads recording at once.
+    std::atomic<ring*> rings{nullptr};
+
+    // Guarded by `lock`.
+    uint16_t sites{0};
+    site_stats stats[telemetry_snapshot::max_sites];
+    uint64_t dropped{0};
+};
+
+registry& global()
+{
+    static registry instance;
+    return instance;
+}
+
+ring* adopt()
+{
+    registry& r = global();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    for (ring* q = r.rings.load(std::memory_order_relaxed); q != nullptr; q = q->next) {
+        if (!q->owned) {
+            q->owned = true;
+            return q;
+        }
+    }
+
+    ring* q = new ring();
+    q->next = r.rings.load(std::memory_order_relaxed);
+    r.rings.store(q, std::memory_order_release);
+    return q;
+}
+
+// Gives ring back on thread exit, records left in it are drained by the next snapshot as usual.
+struct ring_owner {
+    ring* mine{nullptr};
+
+    ~ring_owner()
+    {
+        if (mine != nullptr) {
+            registry& r = global();
+            std::lock_guard<std::mutex> guard(r.lock);
+            mine->owned = false;
+        }
+    }
+};
+
+ring& local()
+{
+    thread_local ring_owner owner;
+
+    if (owner.mine == nullptr) {
+        [[unlikely]] owner.mine = adopt();
+    }
+
+    return *owner.mine;
+}
+
+void drain(registry& r)
+{
+    for (ring* q = r.rings.load(std::memory_order_acquire); q != nullptr; q = q->next) {
+        uint64_t tail = q->tail.load(std::memory_order_relaxed);
+        uint64_t head = q->head.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail) {
+            const solve_record& record = q->records[tail & (ring::capacity - 1)];
+            size_t mode                = size_t(record.mode);
+
+            // Site is whatever caller passed to `record(...)`, unknown ones are counted as dropped.
+            if (record.site == 0 || record.site > r.sites || mode >= size_t(solve_mode::count)) {
+                [[unlikely]] ++r.dropped;
+                continue;
+            }
+
+            site_stats& stats = r.stats[record.site - 1];
+
+            ++stats.calls[mode];
+            if (!record.good) {
+                ++stats.failures[mode];
+            }
+            stats.latency.add(record.ticks);
+            ++stats.sizes[std::bit_width(record.n)];
+        }
+
+        q->tail.store(tail, std::memory_order_release);
+        r.dropped += q->dropped.exchange(0, std::memory_order_relaxed);
+    }
+}
+} // namespace
+
+void histogram::add(const histogram& other)
+{
+    for (size_t i = 0; i < buckets; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+}
+
+uint64_t histogram::percentile(double p) const
+{
+    if (total_ == 0) {
+        return 0;
+    }
+
+    uint64_t rank = uint64_t(p * double(total_));
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < buckets; ++i) {
+        seen += counts_[i];
+        if (seen > rank || seen == total_) {
+            return bound(i);
+        }
+    }
+
+    return bound(buckets - 1);
+}
+
+uint64_t histogram::bound(size_t index)
+{
+    if (index < sub) {
+        return uint64_t(index);
+    }
+
+    size_t shift = index / sub - 1;
+    uint64_t low = uint64_t(sub + index % sub) << shift;
+    return low + ((uint64_t(1) << shift) - 1);
+}
+
+uint16_t telemetry::site(const char* name)
+{
+    registry& r = global();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    if (r.sites == telemetry_snapshot::max_sites) {
+        return 0;
+    }
+
+    r.stats[r.sites].name = name;
+    return ++r.sites;
+}
+
+void telemetry::record(uint16_t site, solve_mode mode, size_t n, uint64_t ticks, bool good)
+{
+    ring& q = local();
+
+    uint64_t head = q.head.load(std::memory_order_relaxed);
+    if (head - q.tail.load(std::memory_order_acquire) == ring::capacity) {
+        [[unlikely]] q.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    q.records[head & (ring::capacity - 1)] = {ticks, uint64_t(n), site, mode, good};
+    q.head.store(head + 1, std::memory_order_release);
+}
+
+void telemetry::snapshot(telemetry_snapshot& out)
+{
+    registry& r = global();
+    std::lock_guard<std::mutex> guard(r.lock);
+
+    drain(r);
+
+    out.count   = r.sites;
+    out.dropped = r.dropped;
+    for (size_t i = 0; i < out.count; ++i) {
+        out.sites[i] = r.stats[i];
+    }
+}
+
+double telemetry::ticks_per_second()
+{
+    static double calibrated = [] {
+        using clock = std::chrono::steady_clock;
+
+        auto start       = clock::now();
+        uint64_t ticks_0 = ticks();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint64_t ticks_1 = ticks();
+        double elapsed   = std::chrono::duration<double>(clock::now() - start).count();
+
+        return double(ticks_1 - ticks_0) / elapsed;
+    }();
+
+    return calibrated;
+}
+
+void telemetry::dump(std::ostream& stream)
+{
+    std::unique_ptr<telemetry_snapshot> s(new telemetry_snapshot());
+    snapshot(*s);
+
+    const char* modes[size_t(solve_mode::count)] = {"fast", "normal", "slow", "incremental", "batch", "blocked"};
+    const double ns                               = 1e9 / ticks_per_second();
+
+    for (size_t i = 0; i < s->count; ++i) {
+        const site_stats& site = s->sites[i];
+
+        stream << "site " << site.name << "\n";
+
+        for (size_t mode = 0; mode < size_t(solve_mode::count); ++mode) {
+            if (site.calls[mode] > 0) {
+                stream << "    " << std::setw(11) << modes[mode] << ": " << site.calls[mode] << " calls, "
+                       << site.failures[mode] << " failed\n";
+            }
+        }
+
+        stream << "    latency ns: p50 " << double(site.latency.percentile(0.5)) * ns << ", p99 "
+               << double(site.latency.percentile(0.99)) * ns << ", p999 "
+               << double(site.latency.percentile(0.999)) * ns << "\n";
+
+        for (size_t bucket = 0; bucket < 65; ++bucket) {
+            if (site.sizes[bucket] > 0) {
+                stream << "    n < 2^" << std::setw(2) << bucket << ": " << site.sizes[bucket] << "\n";
+            }
+        }
+    }
+
+    stream << "dropped " << s->dropped << std::endl;
+}
+} // namespace cmp
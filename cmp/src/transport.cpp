@@ -0,0 +1,121 @@
+#include "transport.hpp"
+
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <new>
+
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "debug.hpp"
+
+namespace cmp
+{
+
+namespace
+{
+
+// Lives at the beginning of the segment, records follow after one cache line.
+struct barrier_state {
+    std::atomic<uint32_t> arrived;
+    std::atomic<uint32_t> generation;
+};
+
+constexpr size_t records_offset = 64;
+
+static_assert(sizeof(barrier_state) <= records_offset);
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Atomics must be address free to be shared.");
+
+void wait(std::atomic<uint32_t>& word, uint32_t value)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, value, nullptr, nullptr, 0);
+#else
+    (void)word;
+    (void)value;
+    sched_yield();
+#endif
+}
+
+void wake(std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+} // namespace
+
+shared_memory_transport::shared_memory_transport(size_t size, size_t capacity)
+    : rank_(0)
+    , size_(size)
+    , capacity_(capacity)
+    , generation_(0)
+    , segment_(records_offset + 2 * size * capacity)
+{
+    // Segment is zero filled by mapping, this is a valid initial barrier state.
+    new (segment_.data()) barrier_state();
+}
+
+void shared_memory_transport::join(size_t rank)
+{
+    if constexpr (debug()) {
+        assert(rank < size_);
+    }
+
+    rank_ = rank;
+}
+
+size_t shared_memory_transport::rank() const
+{
+    return rank_;
+}
+
+size_t shared_memory_transport::size() const
+{
+    return size_;
+}
+
+void shared_memory_transport::allgather(const void* send, void* recv, size_t bytes)
+{
+    if constexpr (debug()) {
+        assert(bytes <= capacity_ && "Record is too big for me!");
+    }
+
+    unsigned char* records = segment_.data() + records_offset + (generation_ % 2) * size_ * capacity_;
+    ++generation_;
+
+    memcpy(records + rank_ * capacity_, send, bytes);
+
+    barrier();
+
+    for (size_t i = 0; i < size_; ++i) {
+        memcpy(reinterpret_cast<unsigned char*>(recv) + i * bytes, records + i * capacity_, bytes);
+    }
+}
+
+void shared_memory_transport::barrier()
+{
+    barrier_state* state = reinterpret_cast<barrier_state*>(segment_.data());
+
+    uint32_t generation = state->generation.load(std::memory_order_acquire);
+
+    if (state->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == size_) {
+        state->arrived.store(0, std::memory_order_relaxed);
+        state->generation.fetch_add(1, std::memory_order_release);
+        wake(state->generation);
+        return;
+    }
+
+    while (state->generation.load(std::memory_order_acquire) == generation) {
+        wait(state->generation, generation);
+    }
+}
+} // namespace cmp
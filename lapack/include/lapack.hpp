@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * LAPACK compatible tridiagonal solvers, callable from C & C++.
+ *
+ * Drop in replacement for `?gtsv`, `?gttrf` & `?gttrs` of reference LAPACK, so switching over is a linker change.
+ * Signatures follow Fortran calling convention as LAPACK does: everything is passed by pointer, integers are
+ * 32 bit (LP64), matrices are column major with leading dimension `ldb`. Hidden string length of `trans`
+ * is not used, so it may be passed or not.
+ *
+ * Off diagonals are n - 1 length: `dl[i]` is A(i + 1, i), `du[i]` is A(i, i + 1).
+ * Arguments are checked as in LAPACK, and `info` is set to -k for invalid argument k, there is no `xerbla`.
+ * Positive `info` is i + 1, when i is the first zero pivot.
+ *
+ * Differences from reference LAPACK:
+ *  - `?gtsv` checks for strict diagonal dominance by columns first, then partial pivoting never swaps, and such
+ *    systems go through the sweep of `tridiagonal_matrix_solver`: 1 division per row instead of 2. Result and
+ *    U in `dl`, `d` & `du` are the ones of reference up to rounding. Other systems are pivoted as reference does,
+ *    with `pivoting_tridiagonal_matrix_solver` kernel, and get exactly the same U.
+ *  - `?gttrf` is `pivoting_tridiagonal_matrix_solver::factor(...)`, factors are the same as of reference
+ *    LAPACK. When some pivot is exactly 0, factors after it are NaN instead of being carried on.
+ *  - `?gttrs` honors `ipiv` & `du2`, so it also solves with factors of reference `?gttrf`.
+ *  - Floating point exception flags of caller are preserved.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sgtsv_(const int* n, const int* nrhs, float* dl, float* d, float* du, float* b, const int* ldb, int* info);
+void dgtsv_(const int* n, const int* nrhs, double* dl, double* d, double* du, double* b, const int* ldb, int* info);
+
+void sgttrf_(const int* n, float* dl, float* d, float* du, float* du2, int* ipiv, int* info);
+void dgttrf_(const int* n, double* dl, double* d, double* du, double* du2, int* ipiv, int* info);
+
+void sgttrs_(
+    const char* trans,
+    const int* n,
+    const int* nrhs,
+    const float* dl,
+    const float* d,
+    const float* du,
+    const float* du2,
+    const int* ipiv,
+    float* b,
+    const int* ldb,
+    int* info);
+void dgttrs_(
+    const char* trans,
+    const int* n,
+    const int* nrhs,
+    const double* dl,
+    const double* d,
+    const double* du,
+    const double* du2,
+    const int* ipiv,
+    double* b,
+    const int* ldb,
+    int* info);
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,282 @@
+#include "lapack.hpp"
+
+#include <algorithm>
+#include <cfenv>
+#include <cmath>
+#include <cstddef>
+
+#include "mod.hpp"
+#include "restrict.hpp"
+#include "tridiagonal_pivoting.hpp"
+
+namespace
+{
+
+// Keeps caller's flags, while solvers use them to detect zero pivots.
+class fenv_guard
+{
+public:
+    static constexpr int flags = FE_DIVBYZERO | FE_INVALID;
+
+    fenv_guard()
+    {
+        std::fegetexceptflag(&saved_, flags);
+        std::feclearexcept(flags);
+    }
+
+    ~fenv_guard()
+    {
+        std::fesetexceptflag(&saved_, flags);
+    }
+
+private:
+    std::fexcept_t saved_;
+};
+
+template <typename real>
+bool zero(real value)
+{
+    return std::fpclassify(value) == FP_ZERO;
+}
+
+// Strictly diagonally dominant by columns: partial pivoting never swaps & no pivot is 0.
+template <typename real>
+bool dominant(size_t n, const real* restrict dl, const real* restrict d, const real* restrict du)
+{
+    for (size_t i = 0; i < n; ++i) {
+        real off = (i > 0 ? cmp::mod(du[i - 1]) : real(0)) + (i + 1 < n ? cmp::mod(dl[i]) : real(0));
+        if (!(cmp::mod(d[i]) > off)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Sweep of `tridiagonal_matrix_solver`, 1 division per row, for systems that need no swaps. Output is U
+// of reference `?gtsv` as well: pivots in `d`, `du` as is, zero second superdiagonal in `dl`.
+// `r` is kept in `dl` until backward substitution, each `dl[i]` is read before it is replaced.
+template <typename real>
+void gtsv_dominant(
+    size_t n,
+    size_t nrhs,
+    real* restrict x,
+    size_t ldx,
+    real* restrict dl,
+    real* restrict d,
+    const real* restrict du)
+{
+    const real last = dl[n - 2];
+
+    real w = real(1) / d[0];
+    real r = du[0] * w;
+    for (size_t j = 0; j < nrhs; ++j) {
+        x[j * ldx] *= w;
+    }
+
+    for (size_t i = 1; i < n; ++i) {
+        const real a = dl[i - 1];
+
+        d[i] -= a * r;
+        dl[i - 1] = r;
+
+        w = real(1) / d[i];
+        r = i + 1 < n ? du[i] * w : real(0);
+        for (size_t j = 0; j < nrhs; ++j) {
+            real* restrict column = x + j * ldx;
+            column[i]             = (column[i] - a * column[i - 1]) * w;
+        }
+    }
+
+    for (size_t j = 0; j < nrhs; ++j) {
+        real* restrict column = x + j * ldx;
+        for (size_t i = n - 1; i > 0; --i) {
+            column[i - 1] -= dl[i - 1] * column[i];
+        }
+    }
+
+    for (size_t i = 0; i + 2 < n; ++i) {
+        dl[i] = real(0);
+    }
+    dl[n - 2] = last;
+}
+
+template <typename real>
+void gtsv(const int* n, const int* nrhs, real* dl, real* d, real* du, real* b, const int* ldb, int* info)
+{
+    *info = 0;
+    if (*n < 0) {
+        *info = -1;
+    } else if (*nrhs < 0) {
+        *info = -2;
+    } else if (*ldb < std::max(1, *n)) {
+        *info = -7;
+    }
+
+    if (*info != 0 || *n == 0 || *nrhs == 0) {
+        return;
+    }
+
+    const size_t size = size_t(*n);
+
+    if (size > 1 && dominant(size, dl, d, du)) {
+        gtsv_dominant(size, size_t(*nrhs), b, size_t(*ldb), dl, d, du);
+        return;
+    }
+
+    // Zero pivots are checked exactly, so there is nothing to divide by zero and no flags to guard.
+    *info = int(cmp::pivoting_tridiagonal_matrix_solver<real>::solve(
+        size_t(*n), size_t(*nrhs), b, size_t(*ldb), dl, d, du));
+}
+
+template <typename real>
+void gttrf(const int* n, real* dl, real* d, real* du, real* du2, int* ipiv, int* info)
+{
+    *info = 0;
+    if (*n < 0) {
+        *info = -1;
+        return;
+    }
+
+    const size_t size = size_t(*n);
+
+    fenv_guard guard;
+
+    cmp::pivoting_tridiagonal_matrix_solver<real>::factor(size, dl, d, du, du2, ipiv);
+
+    // Pivots before the first zero one are exactly as in reference LAPACK.
+    for (size_t i = 0; i < size; ++i) {
+        if (zero(d[i])) {
+            *info = int(i + 1);
+            break;
+        }
+    }
+}
+
+// Column `x` with transposed L U = P A factors, as `?gtts2` does.
+template <typename real>
+void gtts2_transposed(
+    size_t n,
+    const real* restrict dl,
+    const real* restrict d,
+    const real* restrict du,
+    const real* restrict du2,
+    const int* restrict ipiv,
+    real* restrict x)
+{
+    x[0] /= d[0];
+    if (n > 1) {
+        x[1] = (x[1] - du[0] * x[0]) / d[1];
+    }
+    for (size_t i = 2; i < n; ++i) {
+        x[i] = (x[i] - du[i - 1] * x[i - 1] - du2[i - 2] * x[i - 2]) / d[i];
+    }
+
+    for (size_t i = n - 1; i-- > 0;) {
+        size_t p = size_t(ipiv[i] - 1);
+        real t   = x[i] - dl[i] * x[i + 1];
+        x[i]     = x[p];
+        x[p]     = t;
+    }
+}
+
+template <typename real>
+void gttrs(
+    const char* trans,
+    const int* n,
+    const int* nrhs,
+    const real* dl,
+    const real* d,
+    const real* du,
+    const real* du2,
+    const int* ipiv,
+    real* b,
+    const int* ldb,
+    int* info)
+{
+    const char t = *trans;
+
+    *info = 0;
+    if (t != 'N' && t != 'n' && t != 'T' && t != 't' && t != 'C' && t != 'c') {
+        *info = -1;
+    } else if (*n < 0) {
+        *info = -2;
+    } else if (*nrhs < 0) {
+        *info = -3;
+    } else if (*ldb < std::max(1, *n)) {
+        *info = -10;
+    }
+
+    if (*info != 0 || *n == 0 || *nrhs == 0) {
+        return;
+    }
+
+    // Matrix is real, so conjugate transpose is transpose.
+    const bool transpose = t != 'N' && t != 'n';
+
+    for (size_t j = 0; j < size_t(*nrhs); ++j) {
+        real* x = b + j * size_t(*ldb);
+
+        if (transpose) {
+            gtts2_transposed(size_t(*n), dl, d, du, du2, ipiv, x);
+        } else {
+            cmp::pivoting_tridiagonal_matrix_solver<real>::solve(size_t(*n), x, dl, d, du, du2, ipiv);
+        }
+    }
+}
+} // namespace
+
+extern "C" {
+
+void sgtsv_(const int* n, const int* nrhs, float* dl, float* d, float* du, float* b, const int* ldb, int* info)
+{
+    gtsv(n, nrhs, dl, d, du, b, ldb, info);
+}
+
+void dgtsv_(const int* n, const int* nrhs, double* dl, double* d, double* du, double* b, const int* ldb, int* info)
+{
+    gtsv(n, nrhs, dl, d, du, b, ldb, info);
+}
+
+void sgttrf_(const int* n, float* dl, float* d, float* du, float* du2, int* ipiv, int* info)
+{
+    gttrf(n, dl, d, du, du2, ipiv, info);
+}
+
+void dgttrf_(const int* n, double* dl, double* d, double* du, double* du2, int* ipiv, int* info)
+{
+    gttrf(n, dl, d, du, du2, ipiv, info);
+}
+
+void sgttrs_(
+    const char* trans,
+    const int* n,
+    const int* nrhs,
+    const float* dl,
+    const float* d,
+    const float* du,
+    const float* du2,
+    const int* ipiv,
+    float* b,
+    const int* ldb,
+    int* info)
+{
+    gttrs(trans, n, nrhs, dl, d, du, du2, ipiv, b, ldb, info);
+}
+
+void dgttrs_(
+    const char* trans,
+    const int* n,
+    const int* nrhs,
+    const double* dl,
+    const double* d,
+    const double* du,
+    const double* du2,
+    const int* ipiv,
+    double* b,
+    const int* ldb,
+    int* info)
+{
+    gttrs(trans, n, nrhs, dl, d, du, du2, ipiv, b, ldb, info);
+}
+}
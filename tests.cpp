@@ -1,11 +1,35 @@
+#include <chrono>
+#include <csignal>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <numbers>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "array.hpp"
+#include "autotune.hpp"
+#include "dispatch.hpp"
+#include "eigen.hpp"
+#include "expression.hpp"
+#include "helmholtz.hpp"
+#include "lapack.hpp"
+#include "partitioned.hpp"
 #include "round.hpp"
+#include "server.hpp"
+#include "shared_allocator.hpp"
+#include "spline.hpp"
+#include "telemetry.hpp"
 #include "tridiagonal.hpp"
+#include "tridiagonal_complex.hpp"
+#include "tridiagonal_pivoting.hpp"
 
 using cmp::array;
+using cmp::complex_array;
+using cmp::complex_tridiagonal_matrix_solver;
+using cmp::pivoting_tridiagonal_matrix_solver;
 using cmp::tridiagonal_matrix_solver;
 
 // Testing utility
@@ -265,6 +289,1214 @@ void test_nondominant()
     test_round(a, b, c, x, res);
 }
 
+void test_incremental()
+{
+    const size_t n = 64;
+
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+    array<double> d(n);
+    array<double> x(n);
+    array<double> res(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = i == 0 ? 0.0 : -1.0;
+        b[i] = 4.0 + double(i % 3);
+        c[i] = i == n - 1 ? 0.0 : -1.0;
+        d[i] = double(i % 5) - 2.0;
+    }
+
+    tridiagonal_matrix_solver<double> solver(tridiagonal_matrix_solver<double>::incremental_reusable(n));
+    tridiagonal_matrix_solver<double> reference(n);
+
+    solver.solve_incremental(x, a, b, c, d, 0, n - 1);
+    reference.solve_slow(res, a, b, c, d);
+    assert(solver.good());
+    assert(res == x);
+
+    // Small localized change
+    b[30] = 7.0;
+    d[31] = 3.0;
+    a[32] = -0.5;
+
+    solver.solve_incremental(x, a, b, c, d, 30, 32);
+    reference.solve_slow(res, a, b, c, d);
+    print(a, b, c, d, x, res);
+
+    assert(solver.good());
+    assert(res == x);
+
+    // Solution far from unit scale, both ways: update must neither stop at once nor never.
+    for (double scale : {1e-6, 1e6}) {
+        array<double> sd(n);
+        for (size_t i = 0; i < n; ++i) {
+            sd[i] = d[i] * scale;
+        }
+
+        solver.solve_incremental(x, a, b, c, sd, 0, n - 1);
+
+        sd[40] = 5.0 * scale;
+        b[41]  = 6.5;
+
+        solver.solve_incremental(x, a, b, c, sd, 40, 41);
+        reference.solve_slow(res, a, b, c, sd);
+
+        assert(solver.good());
+        for (size_t i = 0; i < n; ++i) {
+            assert(cmp::isclose(x[i] / scale, res[i] / scale, 100.0));
+        }
+    }
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_complex()
+{
+    using complex = std::complex<double>;
+
+    // Crank-Nicolson like system
+    array<complex> a   = {{+0.0, +0.0}, {-1.0, +0.5}, {-1.0, +0.5}, {-1.0, +0.5}};
+    array<complex> b   = {{+2.0, +3.0}, {+2.0, +3.0}, {+2.0, +3.0}, {+2.0, +3.0}};
+    array<complex> c   = {{-1.0, -0.5}, {-1.0, -0.5}, {-1.0, -0.5}, {+0.0, +0.0}};
+    array<complex> x   = {{+1.0, +0.0}, {+0.0, +1.0}, {-1.0, +0.0}, {+0.5, -0.5}};
+    array<complex> d   = x;
+    array<complex> res = x;
+
+    complex_array<double> sa  = {a[0], a[1], a[2], a[3]};
+    complex_array<double> sb  = {b[0], b[1], b[2], b[3]};
+    complex_array<double> sc  = {c[0], c[1], c[2], c[3]};
+    complex_array<double> sx  = {x[0], x[1], x[2], x[3]};
+    complex_array<double> sx2 = sx;
+    complex_array<double> sc2 = sc;
+
+    tridiagonal_matrix_solver<complex> reference(x.size());
+    reference.solve(res, a, b, c);
+    assert(reference.good());
+
+    complex_tridiagonal_matrix_solver<double> solver(x.size());
+    solver.solve(sx, sa, sb, sc);
+    solver.solve_fast(sx2, sa, sb, sc2);
+
+    for (size_t i = 0; i < x.size(); ++i) {
+        x[i] = sx[i];
+    }
+    print(a, b, c, d, x, res);
+
+    assert(solver.good());
+    for (size_t i = 0; i < x.size(); ++i) {
+        assert(cmp::isclose(sx[i], res[i], 100.0));
+        assert(cmp::isclose(sx2[i], res[i], 100.0));
+    }
+
+    // Residual of the original system
+    for (size_t i = 0; i < x.size(); ++i) {
+        complex r = b[i] * res[i];
+        if (i > 0) {
+            r += a[i] * res[i - 1];
+        }
+        if (i + 1 < x.size()) {
+            r += c[i] * res[i + 1];
+        }
+        assert(cmp::isclose(r, d[i], 100.0));
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_spline()
+{
+    using cmp::cubic_spline_batch;
+
+    // Clamped spline reproduces any cubic, natural spline reproduces any line.
+    auto cubic     = [](double t) { return t * t * t - 2.0 * t + 1.0; };
+    auto cubic_d   = [](double t) { return 3.0 * t * t - 2.0; };
+    auto quadratic = [](double t) { return 2.0 * t * t + t; };
+    auto line      = [](double t) { return 3.0 * t + 1.0; };
+
+    array<double> t = {-1.0, -0.7, 0.0, 0.1, 0.5, 1.3, 2.0};
+    array<double> q = {-1.5, -1.0, -0.8, -0.7, 0.05, 0.3, 0.99, 1.3, 1.31, 2.0, 2.5};
+    const size_t n  = t.size();
+
+    array<double> y(n * 2);
+    array<double> l(n);
+    for (size_t i = 0; i < n; ++i) {
+        y[i * 2 + 0] = cubic(t[i]);
+        y[i * 2 + 1] = quadratic(t[i]);
+        l[i]         = line(t[i]);
+    }
+
+    array<double> left  = {cubic_d(t[0]), 4.0 * t[0] + 1.0};
+    array<double> right = {cubic_d(t[n - 1]), 4.0 * t[n - 1] + 1.0};
+
+    cubic_spline_batch<double> clamped(n, 2);
+    clamped.fit(t, y, left, right);
+    assert(clamped.good());
+
+    cubic_spline_batch<double> natural(n, 1);
+    natural.fit(t, l);
+    assert(natural.good());
+
+    array<double> out(q.size() * 2);
+    array<double> out_line(q.size());
+    clamped.evaluate(q, out);
+    natural.evaluate(q, out_line);
+
+    array<double> res(q.size());
+    array<double> act(q.size());
+    for (size_t j = 0; j < q.size(); ++j) {
+        res[j] = cubic(q[j]);
+        act[j] = out[j * 2 + 0];
+    }
+    std::cout << "expected: ";
+    print(res);
+    std::cout << "actual:   ";
+    print(act);
+
+    for (size_t j = 0; j < q.size(); ++j) {
+        assert(cmp::isclose(out[j * 2 + 0], cubic(q[j]), 1000.0));
+        assert(cmp::isclose(out[j * 2 + 1], quadratic(q[j]), 1000.0));
+        assert(cmp::isclose(out_line[j], line(q[j]), 1000.0));
+    }
+
+    // Many small intervals: determinant of the system underflows, but it is well conditioned.
+    // Knots cluster at 0, so one lookup cell holds many of them.
+    for (size_t knots : {128, 256, 1000}) {
+        array<double> tk(knots);
+        array<double> yk(knots);
+        for (size_t i = 0; i < knots; ++i) {
+            double u = double(i) / double(knots - 1);
+            tk[i]    = u * u * u;
+            yk[i]    = line(tk[i]);
+        }
+
+        cubic_spline_batch<double> many(knots, 1);
+        many.fit(tk, yk);
+        assert(many.good());
+
+        array<double> qk = {0.0, 1e-9, 1e-6, 3e-4, 0.01, 0.5, 0.999, 1.0};
+        array<double> ok(qk.size());
+        many.evaluate(qk, ok);
+        for (size_t j = 0; j < qk.size(); ++j) {
+            assert(std::fabs(ok[j] - line(qk[j])) < 1e-12);
+        }
+
+        // Interpolates values at knots.
+        many.evaluate(tk, yk);
+        for (size_t i = 0; i < knots; ++i) {
+            assert(std::fabs(yk[i] - line(tk[i])) < 1e-12);
+        }
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_partitioned()
+{
+    using cmp::partitioned_tridiagonal_matrix_solver;
+    using cmp::shared_allocator;
+    using cmp::shared_memory_transport;
+
+    const size_t parts          = 3;
+    const size_t sizes[parts]   = {5, 2, 7};
+    const size_t offsets[parts] = {0, 5, 7};
+    const size_t n              = 14;
+
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+    array<double> d(n);
+    array<double> res(n);
+    array<double, shared_allocator> x(n);
+
+    auto fill = [&](double scale) {
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = i == 0 ? 0.0 : scale * (-1.0 + 0.1 * double(i % 4));
+            b[i] = scale * (4.0 + double(i % 3));
+            c[i] = i == n - 1 ? 0.0 : scale * (-1.0 - 0.2 * double(i % 2));
+            d[i] = scale * (double(i % 5) - 2.0);
+            x[i] = 0.0;
+        }
+    };
+
+    fill(1.0);
+    tridiagonal_matrix_solver<double> reference(n);
+    reference.solve_slow(res, a, b, c, d);
+
+    // Scaled system has the same solution. At 1e-80 determinant of reduced system underflows to 0,
+    // but the system is as well conditioned as unscaled one.
+    for (double scale : {1.0, 1e-80}) {
+        fill(scale);
+
+        shared_memory_transport transport(parts, partitioned_tridiagonal_matrix_solver<double>::exchange_size());
+
+        // Every partition is solved by its own child process, this one only watches them. Child that dies
+        // before the exchange leaves the others waiting in it forever, so they are killed and the test fails.
+        std::cout.flush();
+        pid_t children[parts];
+        for (size_t rank = 0; rank < parts; ++rank) {
+            children[rank] = fork();
+            assert(children[rank] >= 0);
+            if (children[rank] != 0) {
+                continue;
+            }
+
+            transport.join(rank);
+
+            const size_t m = sizes[rank];
+            array<double> la(m);
+            array<double> lb(m);
+            array<double> lc(m);
+            array<double> lx(m);
+            for (size_t i = 0; i < m; ++i) {
+                la[i] = a[offsets[rank] + i];
+                lb[i] = b[offsets[rank] + i];
+                lc[i] = c[offsets[rank] + i];
+                lx[i] = d[offsets[rank] + i];
+            }
+
+            partitioned_tridiagonal_matrix_solver<double> solver(transport, m);
+            solver.solve(lx, la, lb, lc);
+
+            for (size_t i = 0; i < m; ++i) {
+                x[offsets[rank] + i] = lx[i];
+            }
+
+            _exit(solver.good() ? 0 : 1);
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+        bool failed        = false;
+        bool reaped[parts] = {};
+        size_t running     = parts;
+        while (running > 0) {
+            for (size_t rank = 0; rank < parts; ++rank) {
+                int status = 0;
+                if (!reaped[rank] && waitpid(children[rank], &status, WNOHANG) == children[rank]) {
+                    reaped[rank] = true;
+                    --running;
+                    failed = failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+                }
+            }
+
+            if (running > 0 && (failed || std::chrono::steady_clock::now() > deadline)) {
+                failed = true;
+                for (size_t rank = 0; rank < parts; ++rank) {
+                    if (!reaped[rank]) {
+                        kill(children[rank], SIGKILL);
+                        waitpid(children[rank], nullptr, 0);
+                    }
+                }
+                running = 0;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        assert(!failed);
+
+        array<double> act(n);
+        for (size_t i = 0; i < n; ++i) {
+            act[i] = x[i];
+        }
+        print(a, b, c, d, act, res);
+
+        for (size_t i = 0; i < n; ++i) {
+            assert(cmp::isclose(act[i], res[i], 100.0));
+        }
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_autotune()
+{
+    using cmp::solve_strategy;
+    using cmp::tuned_tridiagonal_matrix_solver;
+    using cmp::tuning_table;
+
+    setenv("THOMAS_TUNE_CACHE", "test_tune.dat", 1);
+
+    array<double> a   = {00.0, 01.0, 02.0};
+    array<double> b   = {03.0, 04.0, 05.0};
+    array<double> c   = {06.0, 07.0, 00.0};
+    array<double> x   = {10.0, 10.0, 10.0};
+    array<double> res = {-15.0, 55.0 / 6.0, -5.0 / 3.0};
+
+    tuned_tridiagonal_matrix_solver<double> solver(8);
+
+    // Every strategy gives the same answer.
+    for (solve_strategy strategy :
+         {solve_strategy::solve_fast, solve_strategy::solve, solve_strategy::solve_slow, solve_strategy::solve_blocked}) {
+        array<double> y = x;
+        solver.solve(strategy, y, a, b, c);
+        assert(solver.good());
+        assert(res == y);
+    }
+
+    // First use of a bucket tunes it and persists decision.
+    array<double> d = x;
+    solver.solve(x, a, b, c);
+    print(a, b, c, d, x, res);
+
+    assert(solver.good());
+    assert(res == x);
+
+    tuning_table& table = tuning_table::instance();
+    solve_strategy tuned = table.get(sizeof(double), tuned_tridiagonal_matrix_solver<double>::bucket_of(3));
+    assert(tuned != solve_strategy::unknown);
+
+    table.set(sizeof(double), tuned_tridiagonal_matrix_solver<double>::bucket_of(3), solve_strategy::unknown);
+    assert(table.load());
+    assert(table.get(sizeof(double), tuned_tridiagonal_matrix_solver<double>::bucket_of(3)) == tuned);
+
+    // Entries of another CPU are neither used nor lost.
+    {
+        std::ofstream other(tuning_table::path(), std::ios::app);
+        other << "Other_CPU 8 40 solve_blocked\n";
+    }
+    table.set(sizeof(double), 40, solve_strategy::unknown);
+    assert(table.load());
+    assert(table.get(sizeof(double), 40) == solve_strategy::unknown);
+    assert(table.save());
+    {
+        std::ifstream saved(tuning_table::path());
+        std::string contents((std::istreambuf_iterator<char>(saved)), std::istreambuf_iterator<char>());
+        assert(contents.find("Other_CPU 8 40 solve_blocked") != std::string::npos);
+        assert(contents.find(tuning_table::cpu()) != std::string::npos);
+    }
+    (void)tuned;
+
+    remove(tuning_table::path());
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_telemetry()
+{
+    using cmp::solve_mode;
+    using cmp::telemetry;
+    using cmp::telemetry_snapshot;
+
+    uint16_t site = telemetry::site("tests");
+    assert(site != 0);
+
+    array<double> a = {00.0, 01.0, 02.0};
+    array<double> b = {03.0, 04.0, 05.0};
+    array<double> c = {06.0, 07.0, 00.0};
+    array<double> z = {00.0, 00.0, 00.0};
+
+    tridiagonal_matrix_solver<double> solver(3);
+    solver.trace(site);
+
+    for (size_t i = 0; i < 100; ++i) {
+        array<double> x = {10.0, 10.0, 10.0};
+        solver.solve(x, a, b, c);
+        assert(solver.good());
+    }
+
+    array<double> x = {10.0, 10.0, 10.0};
+    solver.solve(x, a, z, c);
+    assert(!solver.good());
+
+    telemetry_snapshot* snapshot = new telemetry_snapshot();
+    telemetry::snapshot(*snapshot);
+    telemetry::dump(std::cout);
+
+    const cmp::site_stats& stats = snapshot->sites[site - 1];
+    assert(snapshot->dropped == 0);
+    assert(stats.calls[size_t(solve_mode::normal)] == 101);
+    assert(stats.failures[size_t(solve_mode::normal)] == 1);
+    assert(stats.sizes[2] == 101);
+    assert(stats.latency.total() == 101);
+    assert(stats.latency.percentile(0.5) <= stats.latency.percentile(0.999));
+    (void)stats;
+
+    // Rings of exited threads are recycled, records left in them are not lost. Unknown site is dropped.
+    for (size_t t = 0; t < 4; ++t) {
+        std::thread worker([site] {
+            for (size_t i = 0; i < 10; ++i) {
+                telemetry::record(site, solve_mode::fast, 3, 1, true);
+            }
+            telemetry::record(uint16_t(site + 100), solve_mode::fast, 3, 1, true);
+        });
+        worker.join();
+    }
+
+    telemetry::snapshot(*snapshot);
+    assert(snapshot->sites[site - 1].calls[size_t(solve_mode::fast)] == 40);
+    assert(snapshot->dropped == 4);
+
+    delete snapshot;
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_blocked()
+{
+    const size_t n = 3 * tridiagonal_matrix_solver<double>::blocked_rows + 17;
+
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+    array<double> x(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = i == 0 ? 0.0 : -1.0 + 0.1 * double(i % 4);
+        b[i] = 4.0 + double(i % 3);
+        c[i] = i == n - 1 ? 0.0 : -1.0 - 0.2 * double(i % 2);
+        x[i] = double(i % 5) - 2.0;
+    }
+
+    array<double> res = x;
+
+    tridiagonal_matrix_solver<double> reference(n);
+    reference.solve(res, a, b, c);
+
+    tridiagonal_matrix_solver<double> solver(tridiagonal_matrix_solver<double>::blocked_reusable(n));
+    solver.solve_blocked(x, a, b, c);
+
+    // Recomputed `r` is bit for bit the forward one. Solution is not bitwise the one of `solve(...)`,
+    // which divides in the last row instead of multiplying by reciprocal, so it is compared up to rounding.
+    assert(solver.good());
+    assert(res == x);
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_lapack()
+{
+    const int n   = 7;
+    const int ldb = n + 1;
+
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+    array<double> d(n);
+
+    for (size_t i = 0; i < size_t(n); ++i) {
+        a[i] = i == 0 ? 0.0 : 1.0 + 0.5 * double(i % 3);
+        b[i] = 5.0 - double(i % 2);
+        c[i] = i == size_t(n) - 1 ? 0.0 : -1.0 - 0.25 * double(i % 4);
+        d[i] = double(i) - 3.0;
+    }
+
+    // LAPACK layout: n - 1 length off diagonals, 2 right parts, padded columns.
+    double dl[n - 1];
+    double dd[n];
+    double du[n - 1];
+    double rhs[2 * ldb];
+
+    for (size_t i = 0; i < size_t(n); ++i) {
+        dd[i]        = b[i];
+        rhs[i]       = d[i];
+        rhs[i + ldb] = 2.0 * d[i];
+        if (i + 1 < size_t(n)) {
+            dl[i] = a[i + 1];
+            du[i] = c[i];
+        }
+    }
+
+    array<double> res = d;
+    tridiagonal_matrix_solver<double> reference(d.size());
+    reference.solve(res, a, b, c);
+
+    // Dominant by columns, so it takes the sweep. U is compared against the reference elimination.
+    double pdl[n - 1];
+    double pdd[n];
+    double pdu[n - 1];
+    double prhs[2 * ldb];
+    std::copy(dl, dl + n - 1, pdl);
+    std::copy(dd, dd + n, pdd);
+    std::copy(du, du + n - 1, pdu);
+    std::copy(rhs, rhs + 2 * ldb, prhs);
+    size_t pivot = pivoting_tridiagonal_matrix_solver<double>::solve(size_t(n), 2, prhs, size_t(ldb), pdl, pdd, pdu);
+    assert(pivot == 0);
+    (void)pivot;
+
+    const int two = 2;
+    int info      = -100;
+    dgtsv_(&n, &two, dl, dd, du, rhs, &ldb, &info);
+
+    assert(info == 0);
+    for (size_t i = 0; i < size_t(n); ++i) {
+        assert(cmp::isclose(rhs[i], res[i], 100.0));
+        assert(cmp::isclose(rhs[i + ldb], 2.0 * res[i], 100.0));
+        assert(cmp::isclose(dd[i], pdd[i], 100.0));
+        if (i + 1 < size_t(n)) {
+            assert(cmp::isclose(dl[i], pdl[i], 100.0));
+            assert(cmp::isclose(du[i], pdu[i], 100.0));
+        }
+    }
+
+    // Factor & solve, both as is and transposed.
+    double du2[n - 2];
+    int ipiv[n];
+
+    for (size_t i = 0; i < size_t(n); ++i) {
+        dd[i]  = b[i];
+        rhs[i] = d[i];
+        if (i + 1 < size_t(n)) {
+            dl[i] = a[i + 1];
+            du[i] = c[i];
+        }
+    }
+
+    const int one = 1;
+    dgttrf_(&n, dl, dd, du, du2, ipiv, &info);
+    assert(info == 0);
+    dgttrs_("N", &n, &one, dl, dd, du, du2, ipiv, rhs, &ldb, &info);
+    assert(info == 0);
+    for (size_t i = 0; i < size_t(n); ++i) {
+        assert(cmp::isclose(rhs[i], res[i], 100.0));
+    }
+
+    for (size_t i = 0; i < size_t(n); ++i) {
+        rhs[i] = d[i];
+    }
+    dgttrs_("T", &n, &one, dl, dd, du, du2, ipiv, rhs, &ldb, &info);
+    assert(info == 0);
+    for (size_t i = 0; i < size_t(n); ++i) {
+        // Transposed row i: c[i - 1] x[i - 1] + b[i] x[i] + a[i + 1] x[i + 1].
+        double r = b[i] * rhs[i];
+        if (i > 0) {
+            r += c[i - 1] * rhs[i - 1];
+        }
+        if (i + 1 < size_t(n)) {
+            r += a[i + 1] * rhs[i + 1];
+        }
+        assert(cmp::isclose(r, d[i], 100.0));
+    }
+
+    // Argument errors & zero pivot.
+    const int negative = -1;
+    dgtsv_(&negative, &one, dl, dd, du, rhs, &ldb, &info);
+    assert(info == -1);
+    dgttrs_("X", &n, &one, dl, dd, du, du2, ipiv, rhs, &ldb, &info);
+    assert(info == -1);
+    dgttrs_("N", &n, &one, dl, dd, du, du2, ipiv, rhs, &one, &info);
+    assert(info == -10);
+
+    // Zero pivot without pivoting, but nonsingular: rows are swapped, as reference does.
+    float sdl[2] = {1.0f, 1.0f};
+    float sd[3]  = {1.0f, 1.0f, 2.0f};
+    float sdu[2] = {1.0f, 1.0f};
+    float sb[3]  = {2.0f, 4.0f, 5.0f};
+
+    const int three = 3;
+    sgtsv_(&three, &one, sdl, sd, sdu, sb, &three, &info);
+    assert(info == 0);
+    assert(cmp::isclose(sb[0], 1.0f) && cmp::isclose(sb[1], 1.0f) && cmp::isclose(sb[2], 2.0f));
+
+    // Singular, first 2 rows are the same.
+    float zdl[2] = {1.0f, 1.0f};
+    float zd[3]  = {1.0f, 1.0f, 1.0f};
+    float zdu[2] = {1.0f, 0.0f};
+    float zb[3]  = {1.0f, 2.0f, 3.0f};
+
+    sgtsv_(&three, &one, zdl, zd, zdu, zb, &three, &info);
+    assert(info == 3);
+
+    // Not diagonally dominant at all, both right parts against pivoting solver.
+    for (size_t i = 0; i < size_t(n); ++i) {
+        b[i]  = 0.1 * double(i % 3);
+        dd[i] = b[i];
+        rhs[i]       = d[i];
+        rhs[i + ldb] = 2.0 * d[i];
+        if (i + 1 < size_t(n)) {
+            dl[i] = a[i + 1];
+            du[i] = c[i];
+        }
+    }
+
+    for (size_t i = 0; i < size_t(n); ++i) {
+        res[i] = d[i];
+    }
+    pivoting_tridiagonal_matrix_solver<double> pivoting(d.size());
+    pivoting.solve(res, a, b, c);
+    assert(pivoting.good());
+
+    dgtsv_(&n, &two, dl, dd, du, rhs, &ldb, &info);
+    assert(info == 0);
+    for (size_t i = 0; i < size_t(n); ++i) {
+        assert(cmp::isclose(rhs[i], res[i], 100.0));
+        assert(cmp::isclose(rhs[i + ldb], 2.0 * res[i], 100.0));
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_pivoting()
+{
+    // Same as in `test_nondominant()`, rows are swapped here.
+    {
+        array<double> a   = {0.000, 10.00, 10.00};
+        array<double> b   = {0.001, 0.001, 0.001};
+        array<double> c   = {-1.00, -1.00, 0.000};
+        array<double> x   = {1.000, 1.000, 1.000};
+        array<double> res = {550.050, -0.450, 5499.500};
+
+        pivoting_tridiagonal_matrix_solver<double> solver(x.size());
+        solver.solve(x, a, b, c);
+
+        for (size_t i = 0; i < x.size(); ++i) {
+            x[i] = round(x[i], 3);
+        }
+
+        assert(solver.good());
+        assert(solver.pivots()[0] == 2);
+        assert(res == x);
+    }
+
+    // Zero diagonal, plain sweep fails at the first row. Factors are reused for the second right part.
+    const size_t n = 8;
+
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+    array<double> d(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = i == 0 ? 0.0 : 1.0 + 0.5 * double(i % 2);
+        b[i] = 0.0;
+        c[i] = i == n - 1 ? 0.0 : 2.0 - 0.25 * double(i % 3);
+        d[i] = double(i) - 2.0;
+    }
+
+    pivoting_tridiagonal_matrix_solver<double> solver(n);
+    solver.factor(a, b, c);
+    assert(solver.good());
+
+    for (size_t k = 1; k <= 2; ++k) {
+        array<double> x = d;
+        for (size_t i = 0; i < n; ++i) {
+            x[i] *= double(k);
+        }
+
+        solver.solve(x);
+        assert(solver.good());
+
+        for (size_t i = 0; i < n; ++i) {
+            double r = b[i] * x[i];
+            if (i > 0) {
+                r += a[i] * x[i - 1];
+            }
+            if (i + 1 < n) {
+                r += c[i] * x[i + 1];
+            }
+            assert(cmp::isclose(r, double(k) * d[i], 100.0));
+        }
+    }
+
+    // Singular.
+    array<double> sa = {0.0, 1.0, 1.0};
+    array<double> sb = {0.0, 0.0, 0.0};
+    array<double> sc = {1.0, 1.0, 0.0};
+    array<double> sx = {1.0, 1.0, 1.0};
+
+    pivoting_tridiagonal_matrix_solver<double> singular(3);
+    singular.solve(sx, sa, sb, sc);
+    assert(!singular.good());
+
+    // Empty system has nothing to solve.
+    array<double> empty(0);
+
+    pivoting_tridiagonal_matrix_solver<double> none(0);
+    none.solve(empty, empty, empty, empty);
+    assert(none.good());
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_expression()
+{
+    const size_t n     = 64;
+    const double alpha = 0.75;
+    const double beta  = -0.125;
+    const double dt    = 0.01;
+
+    array<double> u(n);
+    array<double> f(n);
+    array<double> a(n);
+    array<double> b(n);
+    array<double> c(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        u[i] = double(i % 7) - 3.0;
+        f[i] = 1.0 + 0.5 * double(i % 3);
+        a[i] = i == 0 ? 0.0 : -1.0;
+        b[i] = 4.0;
+        c[i] = i == n - 1 ? 0.0 : -1.0;
+    }
+
+    // Neighbours only in interior, boundary rows are separate.
+    array<double> d(n);
+    d = alpha * u + f * dt;
+    cmp::assign(d, alpha * u + beta * (cmp::shift(u, -1) + cmp::shift(u, 1)) + f * dt, 1, n - 1);
+
+    for (size_t i = 0; i < n; ++i) {
+        double expected = alpha * u[i] + f[i] * dt;
+        if (i > 0 && i < n - 1) {
+            expected = alpha * u[i] + beta * (u[i - 1] + u[i + 1]) + f[i] * dt;
+        }
+        assert(cmp::isclose(d[i], expected));
+        (void)expected;
+    }
+
+    // Scalars follow precision of arrays.
+    array<float> g = {1.0f, 2.0f, 4.0f};
+    array<float> h(3);
+    h = -(g / 2.0) + 1;
+    assert(h == array<float>({0.5f, 0.0f, -1.0f}));
+
+    // `d` goes straight into forward sweep.
+    tridiagonal_matrix_solver<double> solver(n);
+
+    array<double> x(n);
+    array<double> res(n);
+
+    d = alpha * u + f * dt - u / 4.0;
+    solver.solve_slow(res, a, b, c, d);
+    assert(solver.good());
+
+    solver.solve_slow(x, a, b, c, alpha * u + f * dt - u / 4.0);
+    assert(solver.good());
+    assert(res == x);
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+// Discrete laplace(u) - sigma * u with zero boundary, 2D grids have nz = 1 and hz = 0.
+array<double>
+helmholtz_apply(const array<double>& u, size_t nx, size_t ny, size_t nz, double hx, double hy, double hz, double sigma)
+{
+    array<double> f(u.size());
+
+    for (size_t l = 0; l < nz; ++l) {
+        for (size_t j = 0; j < ny; ++j) {
+            for (size_t i = 0; i < nx; ++i) {
+                size_t p = (l * ny + j) * nx + i;
+
+                double left  = i > 0 ? u[p - 1] : 0.0;
+                double right = i + 1 < nx ? u[p + 1] : 0.0;
+                double down  = j > 0 ? u[p - nx] : 0.0;
+                double up    = j + 1 < ny ? u[p + nx] : 0.0;
+
+                f[p] = (left - 2.0 * u[p] + right) / (hx * hx) + (down - 2.0 * u[p] + up) / (hy * hy) - sigma * u[p];
+
+                if (nz > 1) {
+                    double back  = l > 0 ? u[p - nx * ny] : 0.0;
+                    double front = l + 1 < nz ? u[p + nx * ny] : 0.0;
+                    f[p] += (back - 2.0 * u[p] + front) / (hz * hz);
+                }
+            }
+        }
+    }
+
+    return f;
+}
+
+void test_helmholtz()
+{
+    // 2D: DST along x only, 2 * (nx + 1) = 16 is radix-2.
+    {
+        const size_t nx = 7;
+        const size_t ny = 5;
+
+        array<double> u(nx * ny);
+        for (size_t p = 0; p < u.size(); ++p) {
+            u[p] = double((p * 7) % 11) - 5.0;
+        }
+
+        array<double> x = helmholtz_apply(u, nx, ny, 1, 0.1, 0.2, 0.0, 0.0);
+
+        cmp::helmholtz_solver<double> solver(nx, ny, 0.1, 0.2);
+        solver.solve(x);
+
+        assert(solver.good());
+        for (size_t p = 0; p < u.size(); ++p) {
+            assert(std::fabs(x[p] - u[p]) < 1e-9);
+        }
+    }
+
+    // 2D: 2 * (nx + 1) = 12 is not a power of 2, so DST goes through Bluestein.
+    {
+        const size_t nx = 5;
+        const size_t ny = 9;
+
+        array<double> u(nx * ny);
+        for (size_t p = 0; p < u.size(); ++p) {
+            u[p] = double((p * 3) % 7) - 3.0;
+        }
+
+        array<double> x = helmholtz_apply(u, nx, ny, 1, 0.3, 0.1, 0.0, 2.0);
+
+        cmp::helmholtz_solver<double> solver(nx, ny, 0.3, 0.1, 2.0);
+        solver.solve(x);
+
+        assert(solver.good());
+        for (size_t p = 0; p < u.size(); ++p) {
+            assert(std::fabs(x[p] - u[p]) < 1e-9);
+        }
+    }
+
+    // 3D Helmholtz.
+    {
+        const size_t nx = 6;
+        const size_t ny = 3;
+        const size_t nz = 4;
+
+        array<double> u(nx * ny * nz);
+        for (size_t p = 0; p < u.size(); ++p) {
+            u[p] = double((p * 5) % 13) - 6.0;
+        }
+
+        array<double> x = helmholtz_apply(u, nx, ny, nz, 0.5, 0.25, 0.4, 3.0);
+
+        cmp::helmholtz_solver<double> solver(nx, ny, nz, 0.5, 0.25, 0.4, 3.0);
+        solver.solve(x);
+
+        assert(solver.good());
+        for (size_t p = 0; p < u.size(); ++p) {
+            assert(std::fabs(x[p] - u[p]) < 1e-9);
+        }
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+void test_eigen()
+{
+    // 1D Laplacian, eigenvalues are 2 - 2 cos(pi k / (n + 1)).
+    {
+        const size_t n = 200;
+
+        array<double> a(n);
+        array<double> b(n);
+        array<double> c(n);
+
+        for (size_t i = 0; i < n; ++i) {
+            a[i] = i == 0 ? 0.0 : -1.0;
+            b[i] = 2.0;
+            c[i] = i == n - 1 ? 0.0 : -1.0;
+        }
+
+        cmp::symmetric_eigen_solver<double> solver(n, 4);
+
+        array<double> values(n);
+        solver.eigenvalues(b, c, 0, n, values);
+        for (size_t k = 0; k < n; ++k) {
+            double expected = 2.0 - 2.0 * std::cos(std::numbers::pi * double(k + 1) / double(n + 1));
+            assert(std::fabs(values[k] - expected) < 1e-12);
+            (void)expected;
+        }
+
+        // Parked workers are woken again for the next call.
+        array<double> again(n);
+        solver.eigenvalues(b, c, 0, n, again);
+        for (size_t k = 0; k < n; ++k) {
+            assert(cmp::isclose(again[k], values[k]));
+        }
+
+        // Value range.
+        assert(solver.count(b, c, 2.0) == n / 2);
+        assert(solver.eigenvalues_between(b, c, 1.0, 3.0, values) == solver.count(b, c, 3.0) - solver.count(b, c, 1.0));
+
+        // Lowest eigenvectors: T v = lambda v.
+        solver.eigenvalues(b, c, 0, 3, values);
+
+        array<double> vectors(3 * n);
+        solver.eigenvectors(b, c, values, 3, vectors);
+        assert(solver.good());
+
+        for (size_t k = 0; k < 3; ++k) {
+            const double* v = vectors.data() + k * n;
+            for (size_t i = 0; i < n; ++i) {
+                double t = b[i] * v[i] + (i > 0 ? a[i] * v[i - 1] : 0.0) + (i + 1 < n ? c[i] * v[i + 1] : 0.0);
+                assert(std::fabs(t - values[k] * v[i]) < 1e-10);
+                (void)t;
+            }
+        }
+    }
+
+    // 2 identical decoupled blocks, so every eigenvalue is double.
+    {
+        const size_t n = 20;
+
+        array<double> b(n);
+        array<double> c(n);
+
+        for (size_t i = 0; i < n; ++i) {
+            b[i] = 1.0 + double(i % 10);
+            c[i] = i % 10 == 9 ? 0.0 : 0.5;
+        }
+
+        cmp::symmetric_eigen_solver<double> solver(n);
+
+        array<double> values(2);
+        solver.eigenvalues(b, c, 0, 2, values);
+        assert(std::fabs(values[0] - values[1]) < 1e-12);
+
+        array<double> vectors(2 * n);
+        solver.eigenvectors(b, c, values, 2, vectors);
+        assert(solver.good());
+
+        double dot = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            dot += vectors[i] * vectors[n + i];
+        }
+        assert(std::fabs(dot) < 1e-10);
+        (void)dot;
+    }
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+// Diagonally dominant system with known solution, `d` is its right part.
+template <typename real>
+void server_system(size_t n, uint32_t seed, array<real>& a, array<real>& b, array<real>& c, array<real>& d, array<real>& x)
+{
+    for (size_t i = 0; i < n; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        a[i] = i == 0 ? real(0) : real(seed % 7) - real(3);
+        c[i] = i == n - 1 ? real(0) : real(seed % 5) - real(2);
+        b[i] = real(8) + real(seed % 3);
+        x[i] = real(seed % 11) - real(5);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        d[i] = b[i] * x[i] + (i > 0 ? a[i] * x[i - 1] : real(0)) + (i + 1 < n ? c[i] * x[i + 1] : real(0));
+    }
+}
+
+template <typename real>
+bool all_close(const array<real>& x, const array<real>& expected, real tolerance)
+{
+    for (size_t i = 0; i < x.size(); ++i) {
+        if (std::fabs(x[i] - expected[i]) > tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_server()
+{
+    const char* path = "test_server.sock";
+
+    cmp::server_config config;
+    config.path       = path;
+    config.max_n      = 1024;
+    config.batch_rows = 64;
+    config.max_batch  = 8;
+    config.budget_us  = 200000;
+
+    cmp::solve_server server(config);
+    bool listening = server.listen();
+    assert(listening);
+    (void)listening;
+
+    std::thread thread([&server] { server.run(); });
+
+    cmp::solve_client client(path);
+    assert(client.connected());
+
+    // Big system is solved right away.
+    {
+        const size_t n = 100;
+
+        array<double> a(n), b(n), c(n), x(n), expected(n);
+        server_system(n, 1, a, b, c, x, expected);
+
+        auto status = client.solve(x, a, b, c);
+        assert(status == cmp::frame_status::ok);
+        assert(all_close(x, expected, 1e-12));
+        (void)status;
+    }
+
+    // Full group of pipelined requests is one batch.
+    {
+        const size_t n     = 16;
+        const size_t count = 8;
+
+        array<double> a(n), b(n), c(n), d(n), x(n);
+        array<double> expected(n * count);
+
+        const uint64_t before = server.stats().batches;
+
+        for (size_t k = 0; k < count; ++k) {
+            array<double> e(n);
+            server_system(n, uint32_t(k + 10), a, b, c, d, e);
+            for (size_t i = 0; i < n; ++i) {
+                expected[k * n + i] = e[i];
+            }
+
+            bool sent = client.submit(100 + k, a, b, c, d);
+            assert(sent);
+            (void)sent;
+        }
+
+        for (size_t k = 0; k < count; ++k) {
+            uint64_t id = 0;
+            auto status = client.receive(id, x);
+            assert(status == cmp::frame_status::ok);
+            assert(id >= 100 && id < 100 + count);
+            (void)status;
+
+            for (size_t i = 0; i < n; ++i) {
+                assert(std::fabs(x[i] - expected[(id - 100) * n + i]) < 1e-12);
+            }
+        }
+
+        assert(server.stats().batches == before + 1);
+        (void)before;
+    }
+
+    // Float system & a singular one in groups of their own, flushed by budget.
+    {
+        const size_t n = 10;
+
+        array<float> a(n), b(n), c(n), x(n), expected(n);
+        server_system(n, 2, a, b, c, x, expected);
+
+        array<double> sa(8), sb(8), sc(8), sx(8), sexpected(8);
+        server_system(8, 3, sa, sb, sc, sx, sexpected);
+        sb[0] = 0.0;
+        sc[0] = 0.0;
+
+        bool sent = client.submit(1, a, b, c, x) && client.submit(2, sa, sb, sc, sx);
+        assert(sent);
+        (void)sent;
+
+        for (size_t k = 0; k < 2; ++k) {
+            uint64_t id = 0;
+            if (k == 0) {
+                auto status = client.receive(id, x);
+                assert(id == 1 && status == cmp::frame_status::ok);
+                assert(all_close(x, expected, 1e-4f));
+                (void)status;
+            } else {
+                auto status = client.receive(id, sx);
+                assert(id == 2 && status == cmp::frame_status::bad_system);
+                (void)status;
+            }
+        }
+    }
+
+    server.stop();
+    thread.join();
+
+    assert(server.stats().requests == 11);
+    assert(server.stats().failed == 1);
+
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
+// Every solve mode, array assignment & comparison under currently selected ISA.
+template <typename real>
+void dispatch_solve(size_t n, size_t count, array<real>* results, bool& equal, bool& singular)
+{
+    array<real> a(n);
+    array<real> b(n);
+    array<real> c(n);
+    array<real> d(n);
+    array<real> expected(n);
+    server_system(n, 7, a, b, c, d, expected);
+
+    tridiagonal_matrix_solver<real> solver(n);
+
+    auto load = [&](array<real>& x) {
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = d[i];
+        }
+    };
+
+    load(results[0]);
+    array<real> cc = c;
+    solver.solve_fast(results[0], a, b, cc);
+    assert(solver.good());
+
+    load(results[1]);
+    solver.solve(results[1], a, b, c);
+    assert(solver.good());
+
+    solver.solve_slow(results[2], a, b, c, d);
+    assert(solver.good());
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t k = 0; k < count; ++k) {
+            results[3][i * count + k] = d[i] * real(k + 1);
+        }
+    }
+    solver.solve_batch(results[3], count, a, b, c);
+    assert(solver.good());
+
+    results[4] = real(0.5) * (a + b) - c / real(4) + d * d;
+
+    equal = results[1] == results[2] && !(results[1] == d);
+
+    array<real> zero = b;
+    for (size_t i = 0; i < n; ++i) {
+        zero[i] = real(0);
+    }
+    load(results[5]);
+    solver.solve(results[5], a, zero, c);
+    singular = !solver.good();
+}
+
+template <typename real>
+void test_dispatch_precision(real tolerance)
+{
+    const size_t n     = 1000;
+    const size_t count = 13;
+
+    array<real> reference[6] = {array<real>(n), array<real>(n), array<real>(n), array<real>(n * count), array<real>(n), array<real>(n)};
+    bool equal;
+    bool singular;
+
+    cmp::isa_dispatch::select(cmp::isa::baseline);
+    dispatch_solve(n, count, reference, equal, singular);
+    assert(equal && singular);
+
+    for (cmp::isa level : {cmp::isa::avx2, cmp::isa::avx512}) {
+        if (cmp::isa_dispatch::select(level) != level) {
+            continue;
+        }
+
+        array<real> results[6] = {array<real>(n), array<real>(n), array<real>(n), array<real>(n * count), array<real>(n), array<real>(n)};
+        dispatch_solve(n, count, results, equal, singular);
+
+        // Wider ISA may contract into FMA, so results are close, not equal.
+        for (size_t m = 0; m < 5; ++m) {
+            assert(all_close(results[m], reference[m], tolerance));
+        }
+        assert(equal && singular);
+        (void)tolerance;
+    }
+}
+
+void test_dispatch()
+{
+    const cmp::isa initial = cmp::isa_dispatch::selected();
+    std::cout << "Detected " << cmp::isa_dispatch::name(cmp::isa_dispatch::detected()) << ", selected "
+              << cmp::isa_dispatch::name(initial) << "." << std::endl;
+
+    for (cmp::isa level : {cmp::isa::baseline, cmp::isa::avx2, cmp::isa::avx512}) {
+        cmp::isa parsed;
+        bool known = cmp::isa_dispatch::parse(cmp::isa_dispatch::name(level), parsed);
+        assert(known && parsed == level);
+        (void)known;
+    }
+
+    cmp::isa parsed;
+    assert(!cmp::isa_dispatch::parse("sse9", parsed));
+    (void)parsed;
+
+    // Never above what CPU has.
+    assert(cmp::isa_dispatch::select(cmp::isa::avx512) == cmp::isa_dispatch::detected());
+
+    test_dispatch_precision<double>(1e-12);
+    test_dispatch_precision<float>(1e-4f);
+
+    cmp::isa_dispatch::select(initial);
+    std::cout << "PASS" << std::endl << std::endl;
+}
+
 int main()
 {
     std::cout << "TEST Identity:" << std::endl;
@@ -291,6 +1523,34 @@ int main()
     test_lower();
     std::cout << "TEST NonDominant:" << std::endl;
     test_nondominant();
+    std::cout << "TEST Incremental:" << std::endl;
+    test_incremental();
+    std::cout << "TEST Blocked:" << std::endl;
+    test_blocked();
+    std::cout << "TEST Expression:" << std::endl;
+    test_expression();
+    std::cout << "TEST Helmholtz:" << std::endl;
+    test_helmholtz();
+    std::cout << "TEST Eigen:" << std::endl;
+    test_eigen();
+    std::cout << "TEST Server:" << std::endl;
+    test_server();
+    std::cout << "TEST Dispatch:" << std::endl;
+    test_dispatch();
+    std::cout << "TEST Pivoting:" << std::endl;
+    test_pivoting();
+    std::cout << "TEST LAPACK:" << std::endl;
+    test_lapack();
+    std::cout << "TEST Complex:" << std::endl;
+    test_complex();
+    std::cout << "TEST Spline:" << std::endl;
+    test_spline();
+    std::cout << "TEST Partitioned:" << std::endl;
+    test_partitioned();
+    std::cout << "TEST Autotune:" << std::endl;
+    test_autotune();
+    std::cout << "TEST Telemetry:" << std::endl;
+    test_telemetry();
 
     std::cout << "TEST First:" << std::endl;
     test_first();